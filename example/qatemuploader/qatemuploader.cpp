@@ -74,12 +74,10 @@ void QAtemUploader::handleMediaLockState(quint8 id, bool locked)
             return;
         }
 
-        QSize size = m_connection->availableVideoModes().value(m_connection->videoFormat()).size;
-
         QFileInfo info(m_filename);
 
         out << tr ("Uploading... ");
-        m_connection->sendDataToSwitcher(0, m_position, info.baseName().toUtf8(), QAtemConnection::prepImageForSwitcher(image, size.width(), size.height()));
+        m_connection->sendDataToSwitcher(0, m_position, info.baseName().toUtf8(), m_connection->prepImageForCurrentVideoMode(image));
         m_state = Inprogress;
     }
     else if(id == 0 && !locked)
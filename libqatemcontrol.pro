@@ -1,4 +1,4 @@
-QT += network
+QT += network concurrent
 
 TARGET = qatemcontrol
 TEMPLATE = lib
@@ -8,7 +8,19 @@ DEFINES += LIBQATEMCONTROL_LIBRARY
 SOURCES += qatemconnection.cpp \
     qatemmixeffect.cpp \
     qatemcameracontrol.cpp \
-    qatemdownstreamkey.cpp
+    qatemdownstreamkey.cpp \
+    qatemimageconverter.cpp \
+    qatemthumbnailcache.cpp \
+    qatemmediasync.cpp \
+    qatemclipuploader.cpp \
+    qatemwavreader.cpp \
+    qatemsounduploader.cpp \
+    qatemaudiometers.cpp \
+    qatemaudiolevelsubscription.cpp \
+    qatemtransaction.cpp \
+    qatemscheduler.cpp \
+    qatemswitcherclock.cpp \
+    qatemautomation.cpp
 
 HEADERS += qatemconnection.h \
         libqatemcontrol_global.h \
@@ -16,7 +28,19 @@ HEADERS += qatemconnection.h \
     qatemmixeffect.h \
     qatemtypes.h \
     qatemcameracontrol.h \
-    qatemdownstreamkey.h
+    qatemdownstreamkey.h \
+    qatemimageconverter.h \
+    qatemthumbnailcache.h \
+    qatemmediasync.h \
+    qatemclipuploader.h \
+    qatemwavreader.h \
+    qatemsounduploader.h \
+    qatemaudiometers.h \
+    qatemaudiolevelsubscription.h \
+    qatemtransaction.h \
+    qatemscheduler.h \
+    qatemswitcherclock.h \
+    qatemautomation.h
 
 macx {
     target.path = /usr/local/lib
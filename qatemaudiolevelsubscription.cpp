@@ -0,0 +1,123 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "qatemaudiolevelsubscription.h"
+#include "qatemconnection.h"
+
+static inline void maximizeLevel(QAtem::AudioLevel &dst, const QAtem::AudioLevel &src)
+{
+    dst.left = qMax(dst.left, src.left);
+    dst.right = qMax(dst.right, src.right);
+    dst.peakLeft = qMax(dst.peakLeft, src.peakLeft);
+    dst.peakRight = qMax(dst.peakRight, src.peakRight);
+}
+
+QAtemAudioLevelSubscription::QAtemAudioLevelSubscription(QAtemConnection *connection, int rate, Aggregation aggregation,
+                                                         QObject *parent) :
+    QObject(parent), m_connection(connection)
+{
+    m_aggregation = aggregation;
+    m_pending = false;
+    m_pendingMasterLevel = QAtem::AudioLevel();
+    m_pendingMonitorLevel = 0;
+    m_masterLevel = QAtem::AudioLevel();
+    m_monitorLevel = 0;
+
+    connect(&m_timer, SIGNAL(timeout()),
+            this, SLOT(deliver()));
+
+    setRate(rate);
+
+    if(m_connection)
+    {
+        m_connection->m_audioLevelSubscriptions.append(this);
+    }
+}
+
+QAtemAudioLevelSubscription::~QAtemAudioLevelSubscription()
+{
+    if(m_connection)
+    {
+        m_connection->m_audioLevelSubscriptions.removeAll(this);
+    }
+}
+
+void QAtemAudioLevelSubscription::setRate(int rate)
+{
+    m_rate = qBound(1, rate, 1000);
+    m_timer.setInterval(1000 / m_rate);
+}
+
+void QAtemAudioLevelSubscription::addLevels(const QVector<QAtem::AudioLevel> &levels, const QAtem::AudioLevel &master, float monitor)
+{
+    if(receivers(SIGNAL(levelsChanged())) == 0)
+    {
+        return;
+    }
+
+    bool sameInputs = m_pending && m_pendingLevels.size() == levels.size();
+
+    for(int i = 0; i < levels.size() && sameInputs; ++i)
+    {
+        sameInputs = m_pendingLevels.at(i).index == levels.at(i).index;
+    }
+
+    if(m_aggregation == LatestLevels || !sameInputs)
+    {
+        m_pendingLevels = levels;
+        m_pendingMasterLevel = master;
+        m_pendingMonitorLevel = monitor;
+    }
+    else
+    {
+        QAtem::AudioLevel *pending = m_pendingLevels.data();
+        const QAtem::AudioLevel *level = levels.constData();
+
+        for(int i = 0; i < levels.size(); ++i)
+        {
+            maximizeLevel(pending[i], level[i]);
+        }
+
+        maximizeLevel(m_pendingMasterLevel, master);
+        m_pendingMonitorLevel = qMax(m_pendingMonitorLevel, monitor);
+    }
+
+    m_pending = true;
+
+    if(!m_timer.isActive())
+    {
+        m_timer.start();
+    }
+}
+
+void QAtemAudioLevelSubscription::deliver()
+{
+    // Run only while levels arrive for someone, addLevels() starts the timer again
+    if(!m_pending || receivers(SIGNAL(levelsChanged())) == 0)
+    {
+        m_timer.stop();
+        m_pending = false;
+        return;
+    }
+
+    m_levels = m_pendingLevels;
+    m_masterLevel = m_pendingMasterLevel;
+    m_monitorLevel = m_pendingMonitorLevel;
+    m_pending = false;
+
+    emit levelsChanged();
+}
@@ -0,0 +1,95 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QATEMAUDIOLEVELSUBSCRIPTION_H
+#define QATEMAUDIOLEVELSUBSCRIPTION_H
+
+#include "libqatemcontrol_global.h"
+#include "qatemtypes.h"
+
+#include <QObject>
+#include <QVector>
+#include <QTimer>
+#include <QPointer>
+
+class QAtemConnection;
+
+/**
+ * Delivers the audio levels of a connection at a fixed rate, independent of how often the switcher sends them.
+ * The levels received between two deliveries are aggregated, so a logger at 1 Hz and a meter at 30 Hz can share
+ * a connection without either of them handling every level packet. The levels are only collected and delivered
+ * while something is connected to levelsChanged(). Audio levels still have to be enabled with
+ * QAtemConnection::setAudioLevelsEnabled().
+ */
+class LIBQATEMCONTROLSHARED_EXPORT QAtemAudioLevelSubscription : public QObject
+{
+    Q_OBJECT
+public:
+    enum Aggregation
+    {
+        LatestLevels, // Deliver the last levels received
+        MaximumLevels // Deliver the highest levels and peaks received since the last delivery
+    };
+
+    /// Subscribe to the levels of @p connection delivered @p rate times per second
+    QAtemAudioLevelSubscription(QAtemConnection *connection, int rate, Aggregation aggregation = MaximumLevels,
+                                QObject *parent = nullptr);
+    ~QAtemAudioLevelSubscription();
+
+    void setRate(int rate);
+    int rate() const { return m_rate; }
+
+    void setAggregation(Aggregation aggregation) { m_aggregation = aggregation; }
+    Aggregation aggregation() const { return m_aggregation; }
+
+    /// @returns the levels of the audio inputs of the last delivery in dB, in the order the switcher sends them
+    const QVector<QAtem::AudioLevel> &levels() const { return m_levels; }
+    /// @returns the master output levels of the last delivery in dB, index is 0
+    QAtem::AudioLevel masterLevel() const { return m_masterLevel; }
+    /// @returns the monitor level of the last delivery in dB
+    float monitorLevel() const { return m_monitorLevel; }
+
+protected slots:
+    void deliver();
+
+protected:
+    /// Called by the connection for every level packet decoded
+    void addLevels(const QVector<QAtem::AudioLevel> &levels, const QAtem::AudioLevel &master, float monitor);
+
+private:
+    QPointer<QAtemConnection> m_connection;
+    int m_rate;
+    Aggregation m_aggregation;
+    QTimer m_timer;
+
+    bool m_pending;
+    QVector<QAtem::AudioLevel> m_pendingLevels;
+    QAtem::AudioLevel m_pendingMasterLevel;
+    float m_pendingMonitorLevel;
+
+    QVector<QAtem::AudioLevel> m_levels;
+    QAtem::AudioLevel m_masterLevel;
+    float m_monitorLevel;
+
+    friend class QAtemConnection;
+
+signals:
+    /// Emitted at most rate() times per second when new levels have been received
+    void levelsChanged();
+};
+
+#endif // QATEMAUDIOLEVELSUBSCRIPTION_H
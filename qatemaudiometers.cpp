@@ -0,0 +1,280 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "qatemaudiometers.h"
+#include "qatemconnection.h"
+
+#include <limits>
+#include <atomic>
+#include <string.h>
+
+static const float MinusInfinity = -std::numeric_limits<float>::infinity();
+
+QAtemAudioMeters::QAtemAudioMeters(QAtemConnection *connection, QObject *parent) :
+    QObject(parent), m_connection(connection)
+{
+    m_updateRate = 30;
+    m_peakHoldTime = 1500;
+    m_decayRate = 20.0f;
+    m_historyLength = 256;
+    m_samples.resize(MaxChannels * m_historyLength);
+    m_channelIds.resize(MaxChannels);
+    m_read = 0;
+
+    // Levels are appended in the thread of the connection, as soon as they are parsed
+    connect(m_connection, SIGNAL(audioLevelsChanged()),
+            this, SLOT(handleAudioLevels()), Qt::DirectConnection);
+    connect(&m_timer, SIGNAL(timeout()),
+            this, SLOT(updateMeters()));
+
+    m_timer.setInterval(1000 / m_updateRate);
+    m_timer.start();
+    m_clock.start();
+}
+
+void QAtemAudioMeters::setUpdateRate(int rate)
+{
+    m_updateRate = qBound(1, rate, 1000);
+    m_timer.setInterval(1000 / m_updateRate);
+}
+
+void QAtemAudioMeters::setHistoryLength(int length)
+{
+    int size = 1;
+
+    while(size < length)
+    {
+        size <<= 1;
+    }
+
+    m_historyLength = size;
+    m_samples.clear();
+    m_samples.resize(MaxChannels * m_historyLength);
+    m_written.storeRelease(0);
+    m_read = 0;
+}
+
+int QAtemAudioMeters::channel(quint16 index) const
+{
+    int count = m_channelCount.loadAcquire();
+
+    for(int i = 0; i < count; ++i)
+    {
+        if(m_channelIds.at(i) == index)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+QAtem::AudioLevel QAtemAudioMeters::meter(quint16 index) const
+{
+    int i = channel(index);
+
+    if(i < 0 || i >= m_meters.size())
+    {
+        return QAtem::AudioLevel();
+    }
+
+    return m_meters.at(i);
+}
+
+int QAtemAudioMeters::history(int channel, QAtem::AudioLevel *dst, int count) const
+{
+    if(!dst || count <= 0 || channel < 0 || channel >= m_channelCount.loadAcquire())
+    {
+        return 0;
+    }
+
+    quint32 length = static_cast<quint32>(m_historyLength);
+    quint32 mask = length - 1;
+    quint32 written = static_cast<quint32>(m_written.loadAcquire());
+    quint32 n = qMin(static_cast<quint32>(count), qMin(written, length));
+    quint32 first = written - n;
+    const Sample *samples = m_samples.constData() + (channel * m_historyLength);
+    quint16 index = m_channelIds.at(channel);
+
+    for(quint32 i = 0; i < n; ++i)
+    {
+        const Sample &s = samples[(first + i) & mask];
+        dst[i].index = index;
+        dst[i].left = s.left;
+        dst[i].right = s.right;
+        dst[i].peakLeft = s.peakLeft;
+        dst[i].peakRight = s.peakRight;
+    }
+
+    // The writer may have overwritten the oldest samples while they were copied, drop those
+    std::atomic_thread_fence(std::memory_order_acquire);
+    quint32 latest = static_cast<quint32>(m_written.loadAcquire());
+    qint64 lost = static_cast<qint64>(latest - first) - (length - 1);
+
+    if(lost <= 0)
+    {
+        return static_cast<int>(n);
+    }
+
+    if(lost >= static_cast<qint64>(n))
+    {
+        return 0;
+    }
+
+    memmove(dst, dst + lost, (n - lost) * sizeof(QAtem::AudioLevel));
+
+    return static_cast<int>(n - lost);
+}
+
+void QAtemAudioMeters::reset()
+{
+    m_level.fill(MinusInfinity);
+    m_peak.fill(MinusInfinity);
+    m_hold.fill(0.0f);
+
+    for(int i = 0; i < m_meters.size(); ++i)
+    {
+        m_meters[i].left = m_meters[i].right = MinusInfinity;
+        m_meters[i].peakLeft = m_meters[i].peakRight = MinusInfinity;
+    }
+}
+
+void QAtemAudioMeters::setChannels(const QVector<QAtem::AudioLevel> &levels)
+{
+    int count = qMin(levels.size(), static_cast<int>(MaxChannels));
+
+    for(int i = 0; i < count; ++i)
+    {
+        m_channelIds[i] = levels.at(i).index;
+    }
+
+    m_channelCount.storeRelease(count);
+
+    m_meters.resize(count);
+
+    for(int i = 0; i < count; ++i)
+    {
+        m_meters[i].index = m_channelIds.at(i);
+    }
+
+    m_current.resize(count * 2);
+    m_level.resize(count * 2);
+    m_peak.resize(count * 2);
+    m_hold.resize(count * 2);
+    reset();
+
+    emit channelsChanged();
+}
+
+void QAtemAudioMeters::handleAudioLevels()
+{
+    const QVector<QAtem::AudioLevel> &levels = m_connection->audioLevels();
+    int count = qMin(levels.size(), static_cast<int>(MaxChannels));
+    bool changed = count != m_channelCount.loadAcquire();
+
+    for(int i = 0; i < count && !changed; ++i)
+    {
+        changed = levels.at(i).index != m_channelIds.at(i);
+    }
+
+    if(changed)
+    {
+        setChannels(levels);
+    }
+
+    quint32 written = static_cast<quint32>(m_written.loadAcquire());
+    quint32 pos = written & static_cast<quint32>(m_historyLength - 1);
+    Sample *samples = m_samples.data() + pos;
+    const QAtem::AudioLevel *level = levels.constData();
+
+    for(int i = 0; i < count; ++i, samples += m_historyLength)
+    {
+        samples->left = level[i].left;
+        samples->right = level[i].right;
+        samples->peakLeft = level[i].peakLeft;
+        samples->peakRight = level[i].peakRight;
+    }
+
+    m_written.storeRelease(static_cast<int>(written + 1));
+}
+
+void QAtemAudioMeters::updateMeters()
+{
+    float elapsed = static_cast<float>(m_clock.restart());
+    int channels = m_meters.size();
+    int n = channels * 2;
+
+    if(channels == 0)
+    {
+        return;
+    }
+
+    // Decimate to the loudest level received for each input since the last update
+    m_current.fill(MinusInfinity);
+    float *current = m_current.data();
+
+    quint32 length = static_cast<quint32>(m_historyLength);
+    quint32 written = static_cast<quint32>(m_written.loadAcquire());
+
+    if(written - m_read > length)
+    {
+        m_read = written - length;
+    }
+
+    const Sample *samples = m_samples.constData();
+
+    for(; m_read != written; ++m_read)
+    {
+        const Sample *s = samples + (m_read & (length - 1));
+
+        for(int c = 0; c < channels; ++c, s += length)
+        {
+            current[c * 2] = qMax(current[c * 2], s->left);
+            current[c * 2 + 1] = qMax(current[c * 2 + 1], s->right);
+        }
+    }
+
+    // Ballistics for all inputs in one branch free pass over flat arrays
+    float decay = m_decayRate * elapsed / 1000.0f;
+    float holdTime = static_cast<float>(m_peakHoldTime);
+    float *level = m_level.data();
+    float *peak = m_peak.data();
+    float *hold = m_hold.data();
+
+    for(int i = 0; i < n; ++i)
+    {
+        float decayed = level[i] - decay;
+        level[i] = current[i] > decayed ? current[i] : decayed;
+        bool newPeak = current[i] >= peak[i];
+        float heldFor = hold[i] - elapsed;
+        float falling = heldFor > 0.0f ? peak[i] : qMax(peak[i] - decay, level[i]);
+        hold[i] = newPeak ? holdTime : heldFor;
+        peak[i] = newPeak ? current[i] : falling;
+    }
+
+    QAtem::AudioLevel *meters = m_meters.data();
+
+    for(int c = 0; c < channels; ++c)
+    {
+        meters[c].left = level[c * 2];
+        meters[c].right = level[c * 2 + 1];
+        meters[c].peakLeft = peak[c * 2];
+        meters[c].peakRight = peak[c * 2 + 1];
+    }
+
+    emit metersUpdated();
+}
@@ -0,0 +1,140 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QATEMAUDIOMETERS_H
+#define QATEMAUDIOMETERS_H
+
+#include "libqatemcontrol_global.h"
+#include "qatemtypes.h"
+
+#include <QObject>
+#include <QVector>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+
+class QAtemConnection;
+
+/**
+ * Keeps a history of the audio levels sent by the switcher and computes meter ballistics for all inputs.
+ *
+ * Every level packet is appended to a ring buffer per input. The ring buffers have a single writer, the thread of
+ * the connection, and can be read with history() from any thread without locking. The meters are updated at a
+ * fixed rate from the samples received since the last update, with a peak hold and a linear decay in dB, and
+ * metersUpdated() is emitted. Rendering the meters is then a read of meters() at the display's refresh rate.
+ * The object has to live in the same thread as the connection.
+ */
+class LIBQATEMCONTROLSHARED_EXPORT QAtemAudioMeters : public QObject
+{
+    Q_OBJECT
+public:
+    enum
+    {
+        MaxChannels = 64
+    };
+
+    explicit QAtemAudioMeters(QAtemConnection *connection, QObject *parent = nullptr);
+
+    /// Set the number of times per second the meters are updated. Default is 30.
+    void setUpdateRate(int rate);
+    int updateRate() const { return m_updateRate; }
+
+    /**
+     * Set the number of samples kept per input, rounded up to a power of two. Default is 256.
+     * Clears the history, so history() must not be called from other threads at the same time.
+     */
+    void setHistoryLength(int length);
+    int historyLength() const { return m_historyLength; }
+
+    /// Set the time in milliseconds a peak is held before it starts to decay. Default is 1500.
+    void setPeakHoldTime(int msecs) { m_peakHoldTime = msecs; }
+    int peakHoldTime() const { return m_peakHoldTime; }
+
+    /// Set how fast the levels and the peaks fall in dB per second. Default is 20.
+    void setDecayRate(float rate) { m_decayRate = rate; }
+    float decayRate() const { return m_decayRate; }
+
+    /// @returns the number of inputs being metered
+    int channelCount() const { return m_meters.size(); }
+    /// @returns the position of audio input @p index in meters(), -1 if it isn't metered
+    int channel(quint16 index) const;
+
+    /**
+     * @returns the ballistic meters of all inputs. left and right are the levels with decay applied,
+     * peakLeft and peakRight are the held peaks. All values are in dB.
+     */
+    const QVector<QAtem::AudioLevel> &meters() const { return m_meters; }
+    /// @returns the ballistic meter of audio input @p index
+    QAtem::AudioLevel meter(quint16 index) const;
+
+    /**
+     * Copy up to @p count of the latest levels received for @p channel to @p dst, oldest first.
+     * Can be called from any thread.
+     * @returns the number of levels copied
+     */
+    int history(int channel, QAtem::AudioLevel *dst, int count) const;
+
+public slots:
+    /// Reset the held peaks and the decay of all meters
+    void reset();
+
+protected slots:
+    void handleAudioLevels();
+    void updateMeters();
+
+private:
+    struct Sample
+    {
+        float left;
+        float right;
+        float peakLeft;
+        float peakRight;
+    };
+
+    void setChannels(const QVector<QAtem::AudioLevel> &levels);
+
+    QAtemConnection *m_connection;
+
+    int m_updateRate;
+    int m_peakHoldTime;
+    float m_decayRate;
+
+    int m_historyLength;
+    QVector<Sample> m_samples;
+    QVector<quint16> m_channelIds;
+    QAtomicInt m_channelCount;
+    QAtomicInt m_written;
+    quint32 m_read;
+
+    // Ballistics, left and right of each input are interleaved
+    QVector<float> m_current;
+    QVector<float> m_level;
+    QVector<float> m_peak;
+    QVector<float> m_hold;
+
+    QVector<QAtem::AudioLevel> m_meters;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+
+signals:
+    /// Emitted when the inputs being metered have changed
+    void channelsChanged();
+    /// Emitted at the update rate when meters() has been updated
+    void metersUpdated();
+};
+
+#endif // QATEMAUDIOMETERS_H
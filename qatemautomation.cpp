@@ -0,0 +1,445 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "qatemautomation.h"
+#include "qatemconnection.h"
+#include "qatemmixeffect.h"
+#include "qatemdownstreamkey.h"
+#include "qatemswitcherclock.h"
+
+#include <math.h>
+
+QAtemAutomation::QAtemAutomation(QAtemConnection *connection, QObject *parent) :
+    QObject(parent), m_connection(connection)
+{
+    m_nextId = 1;
+
+    m_clock.start();
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, SIGNAL(timeout()),
+            this, SLOT(tick()));
+}
+
+void QAtemAutomation::setClock(QAtemSwitcherClock *clock)
+{
+    m_switcherClock = clock;
+}
+
+QAtemSwitcherClock *QAtemAutomation::clock() const
+{
+    return m_switcherClock;
+}
+
+int QAtemAutomation::rampAudioInputGain(quint16 input, float gain, int frames, const QEasingCurve &curve)
+{
+    if(!m_connection)
+    {
+        return -1;
+    }
+
+    Ramp ramp;
+    ramp.parameter = AudioInputGain;
+    ramp.index = input;
+    ramp.from[0] = m_connection->audioInput(input).gain;
+    ramp.to[0] = gain;
+    ramp.curve = curve;
+
+    return addRamp(ramp, frames);
+}
+
+int QAtemAutomation::rampAudioMasterOutputGain(float gain, int frames, const QEasingCurve &curve)
+{
+    if(!m_connection)
+    {
+        return -1;
+    }
+
+    Ramp ramp;
+    ramp.parameter = AudioMasterOutputGain;
+    ramp.from[0] = m_connection->audioMasterOutputGain();
+    ramp.to[0] = gain;
+    ramp.curve = curve;
+
+    return addRamp(ramp, frames);
+}
+
+int QAtemAutomation::rampUpstreamKeyDVEPosition(quint8 me, quint8 keyer, float xPosition, float yPosition, int frames,
+                                                const QEasingCurve &curve)
+{
+    QAtemMixEffect *mixEffect = m_connection ? m_connection->mixEffect(me) : nullptr;
+
+    if(!mixEffect || keyer >= mixEffect->upstreamKeyCount())
+    {
+        return -1;
+    }
+
+    Ramp ramp;
+    ramp.parameter = UpstreamKeyDVEPosition;
+    ramp.index = me;
+    ramp.keyer = keyer;
+    ramp.from[0] = mixEffect->upstreamKeyDVEXPosition(keyer);
+    ramp.from[1] = mixEffect->upstreamKeyDVEYPosition(keyer);
+    ramp.to[0] = xPosition;
+    ramp.to[1] = yPosition;
+    ramp.curve = curve;
+
+    return addRamp(ramp, frames);
+}
+
+int QAtemAutomation::rampUpstreamKeyDVESize(quint8 me, quint8 keyer, float xSize, float ySize, int frames,
+                                            const QEasingCurve &curve)
+{
+    QAtemMixEffect *mixEffect = m_connection ? m_connection->mixEffect(me) : nullptr;
+
+    if(!mixEffect || keyer >= mixEffect->upstreamKeyCount())
+    {
+        return -1;
+    }
+
+    Ramp ramp;
+    ramp.parameter = UpstreamKeyDVESize;
+    ramp.index = me;
+    ramp.keyer = keyer;
+    ramp.from[0] = mixEffect->upstreamKeyDVEXSize(keyer);
+    ramp.from[1] = mixEffect->upstreamKeyDVEYSize(keyer);
+    ramp.to[0] = xSize;
+    ramp.to[1] = ySize;
+    ramp.curve = curve;
+
+    return addRamp(ramp, frames);
+}
+
+int QAtemAutomation::rampUpstreamKeyDVERotation(quint8 me, quint8 keyer, float rotation, int frames,
+                                                const QEasingCurve &curve)
+{
+    QAtemMixEffect *mixEffect = m_connection ? m_connection->mixEffect(me) : nullptr;
+
+    if(!mixEffect || keyer >= mixEffect->upstreamKeyCount())
+    {
+        return -1;
+    }
+
+    Ramp ramp;
+    ramp.parameter = UpstreamKeyDVERotation;
+    ramp.index = me;
+    ramp.keyer = keyer;
+    ramp.from[0] = mixEffect->upstreamKeyDVERotation(keyer);
+    ramp.to[0] = rotation;
+    ramp.curve = curve;
+
+    return addRamp(ramp, frames);
+}
+
+int QAtemAutomation::rampDownstreamKeyClip(quint8 keyer, float clip, int frames, const QEasingCurve &curve)
+{
+    QAtemDownstreamKey *downstreamKey = m_connection ? m_connection->downstreamKey(keyer) : nullptr;
+
+    if(!downstreamKey)
+    {
+        return -1;
+    }
+
+    Ramp ramp;
+    ramp.parameter = DownstreamKeyClip;
+    ramp.index = keyer;
+    ramp.from[0] = downstreamKey->clip();
+    ramp.to[0] = clip;
+    ramp.curve = curve;
+
+    return addRamp(ramp, frames);
+}
+
+int QAtemAutomation::rampDownstreamKeyGain(quint8 keyer, float gain, int frames, const QEasingCurve &curve)
+{
+    QAtemDownstreamKey *downstreamKey = m_connection ? m_connection->downstreamKey(keyer) : nullptr;
+
+    if(!downstreamKey)
+    {
+        return -1;
+    }
+
+    Ramp ramp;
+    ramp.parameter = DownstreamKeyGain;
+    ramp.index = keyer;
+    ramp.from[0] = downstreamKey->gain();
+    ramp.to[0] = gain;
+    ramp.curve = curve;
+
+    return addRamp(ramp, frames);
+}
+
+int QAtemAutomation::rampColorGeneratorColor(quint8 generator, const QColor &color, int frames, const QEasingCurve &curve)
+{
+    if(!m_connection)
+    {
+        return -1;
+    }
+
+    QColor current = m_connection->colorGeneratorColor(generator);
+
+    Ramp ramp;
+    ramp.parameter = ColorGeneratorColor;
+    ramp.index = generator;
+    ramp.from[0] = static_cast<float>(current.hslHueF() * 360.0);
+    ramp.from[1] = static_cast<float>(current.hslSaturationF());
+    ramp.from[2] = static_cast<float>(current.lightnessF());
+    ramp.to[0] = static_cast<float>(color.hslHueF() * 360.0);
+    ramp.to[1] = static_cast<float>(color.hslSaturationF());
+    ramp.to[2] = static_cast<float>(color.lightnessF());
+    ramp.curve = curve;
+
+    // Grays have no hue, keep the hue of the other end so only saturation and lightness move
+    if(ramp.from[0] < 0)
+    {
+        ramp.from[0] = qMax(0.0f, ramp.to[0]);
+    }
+
+    if(ramp.to[0] < 0)
+    {
+        ramp.to[0] = ramp.from[0];
+    }
+
+    // Go the shortest way round the hue circle
+    if(ramp.to[0] - ramp.from[0] > 180.0f)
+    {
+        ramp.to[0] -= 360.0f;
+    }
+    else if(ramp.from[0] - ramp.to[0] > 180.0f)
+    {
+        ramp.to[0] += 360.0f;
+    }
+
+    return addRamp(ramp, frames);
+}
+
+void QAtemAutomation::stop(int id)
+{
+    for(int i = 0; i < m_ramps.size(); ++i)
+    {
+        if(m_ramps.at(i).id == id)
+        {
+            m_ramps.removeAt(i);
+            break;
+        }
+    }
+
+    if(m_ramps.isEmpty())
+    {
+        m_timer.stop();
+    }
+}
+
+void QAtemAutomation::stopAll()
+{
+    m_ramps.clear();
+    m_timer.stop();
+}
+
+bool QAtemAutomation::isRunning(int id) const
+{
+    foreach(const Ramp &ramp, m_ramps)
+    {
+        if(ramp.id == id)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void QAtemAutomation::tick()
+{
+    if(m_ramps.isEmpty() || !m_connection)
+    {
+        return;
+    }
+
+    qint64 now = m_clock.elapsed();
+    QList<int> finishedRamps;
+
+    // All ramps of a tick go out in one datagram, a transaction the caller has open must not hold the frame back
+    QPointer<QAtemTransaction> callerTransaction = m_connection->currentTransaction();
+
+    if(callerTransaction)
+    {
+        callerTransaction->detach();
+    }
+
+    QPointer<QAtemTransaction> transaction = m_connection->beginTransaction();
+
+    for(int i = 0; i < m_ramps.size();)
+    {
+        const Ramp &ramp = m_ramps.at(i);
+        qreal progress = ramp.duration > 0 ? qMin(1.0, (now - ramp.start) / ramp.duration) : 1.0;
+
+        applyRamp(ramp, progress);
+
+        if(progress >= 1.0)
+        {
+            finishedRamps.append(ramp.id);
+            m_ramps.removeAt(i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    if(transaction)
+    {
+        transaction->commit();
+    }
+
+    if(callerTransaction)
+    {
+        callerTransaction->attach();
+    }
+
+    scheduleTick();
+
+    foreach(int id, finishedRamps)
+    {
+        emit finished(id);
+    }
+}
+
+int QAtemAutomation::addRamp(Ramp &ramp, int frames)
+{
+    ramp.id = m_nextId++;
+    ramp.start = m_clock.elapsed();
+    ramp.duration = qMax(0, frames) * frameDuration();
+
+    for(int i = 0; i < m_ramps.size(); ++i)
+    {
+        const Ramp &running = m_ramps.at(i);
+
+        if(running.parameter == ramp.parameter && running.index == ramp.index && running.keyer == ramp.keyer)
+        {
+            m_ramps.removeAt(i);
+            break;
+        }
+    }
+
+    m_ramps.append(ramp);
+
+    if(!m_timer.isActive())
+    {
+        scheduleTick();
+    }
+
+    return ramp.id;
+}
+
+void QAtemAutomation::applyRamp(const Ramp &ramp, qreal progress)
+{
+    float value = static_cast<float>(ramp.curve.valueForProgress(progress));
+    float values[3];
+
+    for(int i = 0; i < 3; ++i)
+    {
+        values[i] = ramp.from[i] + ((ramp.to[i] - ramp.from[i]) * value);
+    }
+
+    switch(ramp.parameter)
+    {
+    case AudioInputGain:
+        m_connection->setAudioInputGain(ramp.index, values[0]);
+        break;
+    case AudioMasterOutputGain:
+        m_connection->setAudioMasterOutputGain(values[0]);
+        break;
+    case UpstreamKeyDVEPosition:
+        if(QAtemMixEffect *mixEffect = m_connection->mixEffect(static_cast<quint8>(ramp.index)))
+        {
+            mixEffect->setUpstreamKeyDVEPosition(ramp.keyer, values[0], values[1]);
+        }
+        break;
+    case UpstreamKeyDVESize:
+        if(QAtemMixEffect *mixEffect = m_connection->mixEffect(static_cast<quint8>(ramp.index)))
+        {
+            mixEffect->setUpstreamKeyDVESize(ramp.keyer, values[0], values[1]);
+        }
+        break;
+    case UpstreamKeyDVERotation:
+        if(QAtemMixEffect *mixEffect = m_connection->mixEffect(static_cast<quint8>(ramp.index)))
+        {
+            mixEffect->setUpstreamKeyDVERotation(ramp.keyer, values[0]);
+        }
+        break;
+    case DownstreamKeyClip:
+        if(QAtemDownstreamKey *downstreamKey = m_connection->downstreamKey(static_cast<quint8>(ramp.index)))
+        {
+            downstreamKey->setClip(values[0]);
+        }
+        break;
+    case DownstreamKeyGain:
+        if(QAtemDownstreamKey *downstreamKey = m_connection->downstreamKey(static_cast<quint8>(ramp.index)))
+        {
+            downstreamKey->setGain(values[0]);
+        }
+        break;
+    case ColorGeneratorColor:
+    {
+        qreal hue = fmod(values[0] + 360.0, 360.0) / 360.0;
+        QColor color = QColor::fromHslF(hue, qBound(0.0f, values[1], 1.0f), qBound(0.0f, values[2], 1.0f));
+        m_connection->setColorGeneratorColor(static_cast<quint8>(ramp.index), color);
+        break;
+    }
+    }
+}
+
+double QAtemAutomation::frameDuration() const
+{
+    if(m_switcherClock && m_switcherClock->isValid())
+    {
+        return m_switcherClock->frameDuration();
+    }
+
+    float frameRate = m_connection ? m_connection->currentVideoMode().framesPerSecond : 0;
+
+    return 1000.0 / (frameRate > 0 ? frameRate : 25.0);
+}
+
+void QAtemAutomation::scheduleTick()
+{
+    if(m_ramps.isEmpty())
+    {
+        m_timer.stop();
+        return;
+    }
+
+    double interval = frameDuration();
+
+    if(m_switcherClock && m_switcherClock->isValid() && m_connection)
+    {
+        // Send so the values arrive just before the next frame starts
+        float rtt = m_connection->roundTripTime();
+        double latency = rtt > 0 ? rtt / 2.0 : 0.0;
+        quint32 frame = static_cast<quint32>(m_switcherClock->currentFrame()) + 1;
+
+        interval = m_switcherClock->msecsUntilFrame(frame % m_switcherClock->framesPerDay()) - latency;
+
+        while(interval < 1.0)
+        {
+            interval += m_switcherClock->frameDuration();
+        }
+    }
+
+    m_timer.start(static_cast<int>(interval));
+}
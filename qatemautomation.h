@@ -0,0 +1,148 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QATEMAUTOMATION_H
+#define QATEMAUTOMATION_H
+
+#include "libqatemcontrol_global.h"
+
+#include <QObject>
+#include <QPointer>
+#include <QList>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QEasingCurve>
+#include <QColor>
+
+class QAtemConnection;
+class QAtemSwitcherClock;
+
+/**
+ * Ramps switcher parameters over a number of frames. All running ramps are evaluated in one tick per frame and the
+ * commands of a tick are sent in one transaction, so any number of simultaneous moves costs one datagram per
+ * frame. The shape of a ramp is a QEasingCurve, use QEasingCurve::Linear, one of the ease types or a
+ * QEasingCurve::BezierSpline built with addCubicBezierSegment().
+ *
+ * A ramp starts from the current state of its parameter and replaces any ramp running on the same parameter.
+ * Ticks follow the frame rate of the current video mode, with a QAtemSwitcherClock set they are aligned to the
+ * switcher's frames.
+ */
+class LIBQATEMCONTROLSHARED_EXPORT QAtemAutomation : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QAtemAutomation(QAtemConnection *connection, QObject *parent = nullptr);
+
+    /// Align the ticks to the frames of @p clock, nullptr to tick on a free running timer
+    void setClock(QAtemSwitcherClock *clock);
+    QAtemSwitcherClock *clock() const;
+
+    /// Ramp the gain of audio input @p input to @p gain dB. @returns the ID of the ramp
+    int rampAudioInputGain(quint16 input, float gain, int frames, const QEasingCurve &curve = QEasingCurve::Linear);
+    /// Ramp the gain of the audio master output to @p gain dB. @returns the ID of the ramp
+    int rampAudioMasterOutputGain(float gain, int frames, const QEasingCurve &curve = QEasingCurve::Linear);
+    /// Ramp the DVE position of upstream key @p keyer on M/E @p me. @returns the ID of the ramp
+    int rampUpstreamKeyDVEPosition(quint8 me, quint8 keyer, float xPosition, float yPosition, int frames,
+                                   const QEasingCurve &curve = QEasingCurve::Linear);
+    /// Ramp the DVE size of upstream key @p keyer on M/E @p me. @returns the ID of the ramp
+    int rampUpstreamKeyDVESize(quint8 me, quint8 keyer, float xSize, float ySize, int frames,
+                               const QEasingCurve &curve = QEasingCurve::Linear);
+    /// Ramp the DVE rotation of upstream key @p keyer on M/E @p me. @returns the ID of the ramp
+    int rampUpstreamKeyDVERotation(quint8 me, quint8 keyer, float rotation, int frames,
+                                   const QEasingCurve &curve = QEasingCurve::Linear);
+    /// Ramp the clip of downstream key @p keyer. @returns the ID of the ramp
+    int rampDownstreamKeyClip(quint8 keyer, float clip, int frames, const QEasingCurve &curve = QEasingCurve::Linear);
+    /// Ramp the gain of downstream key @p keyer. @returns the ID of the ramp
+    int rampDownstreamKeyGain(quint8 keyer, float gain, int frames, const QEasingCurve &curve = QEasingCurve::Linear);
+    /**
+     * Ramp color generator @p generator to @p color. The color is ramped in HSL, the hue the shortest way round.
+     * @returns the ID of the ramp
+     */
+    int rampColorGeneratorColor(quint8 generator, const QColor &color, int frames,
+                                const QEasingCurve &curve = QEasingCurve::Linear);
+
+    /// Stop the ramp with ID @p id where it is
+    void stop(int id);
+    /// Stop all ramps where they are
+    void stopAll();
+    /// @returns true if the ramp with ID @p id is running
+    bool isRunning(int id) const;
+    /// @returns the number of running ramps
+    int runningCount() const { return m_ramps.size(); }
+
+protected slots:
+    /// Evaluate all ramps, send their values and schedule the next tick
+    void tick();
+
+protected:
+    enum Parameter
+    {
+        AudioInputGain,
+        AudioMasterOutputGain,
+        UpstreamKeyDVEPosition,
+        UpstreamKeyDVESize,
+        UpstreamKeyDVERotation,
+        DownstreamKeyClip,
+        DownstreamKeyGain,
+        ColorGeneratorColor
+    };
+
+    struct Ramp
+    {
+        Ramp() : id(0), parameter(AudioInputGain), index(0), keyer(0), start(0), duration(0)
+        {
+            for(int i = 0; i < 3; ++i)
+            {
+                from[i] = 0;
+                to[i] = 0;
+            }
+        }
+
+        int id;
+        Parameter parameter;
+        quint16 index; // Audio input, M/E, downstream key or color generator
+        quint8 keyer;
+        float from[3];
+        float to[3];
+        qint64 start;
+        double duration;
+        QEasingCurve curve;
+    };
+
+    /// Start @p ramp, replacing the ramp running on the same parameter. @returns the ID of the ramp
+    int addRamp(Ramp &ramp, int frames);
+    /// Send the values of @p ramp at @p progress
+    void applyRamp(const Ramp &ramp, qreal progress);
+    /// @returns the duration of a frame in milliseconds
+    double frameDuration() const;
+    void scheduleTick();
+
+private:
+    QPointer<QAtemConnection> m_connection;
+    QPointer<QAtemSwitcherClock> m_switcherClock;
+    QList<Ramp> m_ramps;
+    int m_nextId;
+
+    QElapsedTimer m_clock;
+    QTimer m_timer;
+
+signals:
+    /// Emitted when the ramp with ID @p id has reached its target
+    void finished(int id);
+};
+
+#endif // QATEMAUTOMATION_H
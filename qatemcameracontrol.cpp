@@ -259,7 +259,15 @@ void QAtemCameraControl::sendCCmd(quint8 input, quint8 hardware, quint8 command,
         break;
     }
 
-    m_atemConnection->sendCommand(cmd, payload);
+    if(append || values.isEmpty())
+    {
+        m_atemConnection->sendCommand(cmd, payload);
+    }
+    else
+    {
+        // Absolute values replace each other, only the latest one per input and parameter needs to be sent
+        m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
+    }
 }
 
 void QAtemCameraControl::setFocus(quint8 input, quint16 focus)
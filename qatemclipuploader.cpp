@@ -0,0 +1,281 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "qatemclipuploader.h"
+#include "qatemconnection.h"
+
+#include <QImage>
+#include <QThread>
+#include <QTimer>
+#include <QtConcurrentRun>
+
+QAtemClipUploader::QAtemClipUploader(QAtemConnection *connection, QObject *parent) :
+    QObject(parent), m_connection(connection)
+{
+    m_scaleMode = QAtem::CropImage;
+    m_prepareAhead = qMax(2, QThread::idealThreadCount());
+    m_state = Idle;
+    m_clip = 0;
+    m_nextPrepare = 0;
+    m_currentFrame = 0;
+    m_transferId = 0;
+    m_locked = false;
+    m_canceled = false;
+
+    connect(&m_frameWatcher, SIGNAL(finished()),
+            this, SLOT(uploadNext()));
+    connect(m_connection, SIGNAL(getLockStateChanged(quint8,bool)),
+            this, SLOT(handleGetLockStateChanged(quint8,bool)));
+    connect(m_connection, SIGNAL(mediaLockStateChanged(quint8,bool)),
+            this, SLOT(handleMediaLockStateChanged(quint8,bool)));
+    connect(m_connection, SIGNAL(dataTransferFinished(quint16)),
+            this, SLOT(handleDataTransferFinished(quint16)));
+    connect(m_connection, SIGNAL(dataTransferFailed(quint16)),
+            this, SLOT(handleDataTransferFailed(quint16)));
+    connect(m_connection, SIGNAL(disconnected()),
+            this, SLOT(handleDisconnected()));
+    connect(m_connection, SIGNAL(connected()),
+            this, SLOT(handleConnected()));
+}
+
+QAtemClipUploader::~QAtemClipUploader()
+{
+    foreach(QFuture<QByteArray> frame, m_frames)
+    {
+        frame.waitForFinished();
+    }
+}
+
+bool QAtemClipUploader::upload(quint8 clip, const QStringList &fileNames, const QString &name)
+{
+    if(m_state != Idle || clip > 1 || fileNames.isEmpty())
+    {
+        return false;
+    }
+
+    quint16 clipSize = (clip == 0) ? m_connection->mediaPoolClip1Size() : m_connection->mediaPoolClip2Size();
+
+    // The frame index sent to the switcher is 16 bits
+    if(fileNames.count() > 0x10000)
+    {
+        emit uploadError(tr("A clip can't have more than %1 frames").arg(0x10000));
+        return false;
+    }
+
+    if(clipSize && fileNames.count() > clipSize)
+    {
+        emit uploadError(tr("Clip %1 only has room for %2 frames").arg(clip + 1).arg(clipSize));
+        return false;
+    }
+
+    m_clip = clip;
+    m_name = name;
+    m_fileNames = fileNames;
+    m_nextPrepare = 0;
+    m_currentFrame = 0;
+    m_transferId = 0;
+    m_canceled = false;
+    m_frames.clear();
+
+    // Start converting while waiting for the lock
+    fillPrepareQueue();
+
+    m_state = AquiringLock;
+
+    if(!m_connection->mediaLockState(QAtemConnection::clipStoreId(m_clip)))
+    {
+        m_connection->aquireMediaLock(QAtemConnection::clipStoreId(m_clip), 0);
+    }
+
+    return true;
+}
+
+void QAtemClipUploader::cancel()
+{
+    if(m_state == Idle)
+    {
+        return;
+    }
+
+    m_canceled = true;
+    m_fileNames = m_fileNames.mid(0, m_currentFrame + 1);
+    m_nextPrepare = qMin(m_nextPrepare, m_fileNames.count());
+
+    if(m_transferId == 0)
+    {
+        finish(false);
+    }
+}
+
+void QAtemClipUploader::fillPrepareQueue()
+{
+    const QSize size = m_connection->currentVideoMode().size;
+    const QAtem::ImageScaleMode mode = m_scaleMode;
+    const QAtem::ColorMatrix matrix = m_connection->colorMatrix();
+
+    while(m_frames.count() < m_prepareAhead && m_nextPrepare < m_fileNames.count())
+    {
+        const QString fileName = m_fileNames.at(m_nextPrepare);
+
+        m_frames.enqueue(QtConcurrent::run([=]() {
+            QImage image(fileName);
+
+            if(image.isNull())
+            {
+                return QByteArray();
+            }
+
+            return QAtemConnection::prepImageForSwitcher(image, size.width(), size.height(), mode, matrix);
+        }));
+
+        ++m_nextPrepare;
+    }
+
+    if(!m_frames.isEmpty() && m_frameWatcher.future() != m_frames.head())
+    {
+        m_frameWatcher.setFuture(m_frames.head());
+    }
+}
+
+void QAtemClipUploader::handleGetLockStateChanged(quint8 storeId, bool state)
+{
+    if(storeId != QAtemConnection::clipStoreId(m_clip) || m_state != AquiringLock || !state)
+    {
+        return;
+    }
+
+    m_locked = true;
+    m_state = Uploading;
+    uploadNext();
+}
+
+void QAtemClipUploader::handleMediaLockStateChanged(quint8 id, bool state)
+{
+    // Released by someone else, try again
+    if(id == QAtemConnection::clipStoreId(m_clip) && !state && m_state == AquiringLock)
+    {
+        m_connection->aquireMediaLock(QAtemConnection::clipStoreId(m_clip), 0);
+    }
+}
+
+void QAtemClipUploader::uploadNext()
+{
+    if(m_state != Uploading || m_transferId != 0 || m_frames.isEmpty() || !m_frames.head().isFinished())
+    {
+        return;
+    }
+
+    // Only one transfer can run at a time
+    if(m_connection->transferActive())
+    {
+        QTimer::singleShot(50, this, SLOT(uploadNext()));
+        return;
+    }
+
+    QByteArray frame = m_frames.head().result();
+
+    if(frame.isEmpty())
+    {
+        emit uploadError(tr("Failed to load image %1").arg(m_fileNames.at(m_currentFrame)));
+        finish(false);
+        return;
+    }
+
+    QByteArray name = QString("%1 %2").arg(m_name).arg(m_currentFrame + 1).toUtf8();
+    m_transferId = m_connection->sendDataToSwitcher(QAtemConnection::clipStoreId(m_clip), static_cast<quint16>(m_currentFrame), name, frame);
+
+    if(m_transferId == 0)
+    {
+        QTimer::singleShot(50, this, SLOT(uploadNext()));
+        return;
+    }
+
+    // The frame is owned by the transfer engine now, free the slot for the next frame to convert
+    m_frames.dequeue();
+    fillPrepareQueue();
+}
+
+void QAtemClipUploader::handleDataTransferFinished(quint16 transferId)
+{
+    if(m_state != Uploading || transferId != m_transferId)
+    {
+        return;
+    }
+
+    m_transferId = 0;
+    ++m_currentFrame;
+
+    emit frameUploaded(m_currentFrame, m_fileNames.count());
+
+    if(m_currentFrame >= m_fileNames.count())
+    {
+        finish(!m_canceled);
+        return;
+    }
+
+    uploadNext();
+}
+
+void QAtemClipUploader::handleDataTransferFailed(quint16 transferId)
+{
+    if(m_state == Uploading && transferId == m_transferId)
+    {
+        emit uploadError(tr("The transfer of frame %1 failed").arg(m_currentFrame + 1));
+        finish(false);
+    }
+}
+
+void QAtemClipUploader::handleDisconnected()
+{
+    // A frame in flight is restarted by the connection after a reconnect. Between frames the clip lock is gone
+    // with the lost session, so wait for the connection and request it again.
+    if(m_state == AquiringLock || (m_state == Uploading && m_transferId == 0))
+    {
+        m_locked = false;
+        m_state = AquiringLock;
+    }
+}
+
+void QAtemClipUploader::handleConnected()
+{
+    if(m_state == AquiringLock && !m_connection->mediaLockState(QAtemConnection::clipStoreId(m_clip)))
+    {
+        m_connection->aquireMediaLock(QAtemConnection::clipStoreId(m_clip), 0);
+    }
+}
+
+void QAtemClipUploader::finish(bool success)
+{
+    if(success)
+    {
+        m_connection->setMediaPoolClip(m_clip, m_name, static_cast<quint16>(m_fileNames.count()));
+    }
+
+    // Also release a lock that was requested but not granted yet, unless the session holding it is gone
+    if((m_locked || m_state == AquiringLock) && m_connection->isConnected())
+    {
+        m_connection->unlockMediaLock(QAtemConnection::clipStoreId(m_clip));
+    }
+
+    m_locked = false;
+    m_state = Idle;
+    m_transferId = 0;
+    m_frames.clear();
+    m_frameWatcher.setFuture(QFuture<QByteArray>());
+
+    emit uploadFinished(success);
+}
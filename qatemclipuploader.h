@@ -0,0 +1,105 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QATEMCLIPUPLOADER_H
+#define QATEMCLIPUPLOADER_H
+
+#include "libqatemcontrol_global.h"
+#include "qatemtypes.h"
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QQueue>
+#include <QStringList>
+
+class QAtemConnection;
+
+/**
+ * Uploads an image sequence to a media pool clip.
+ * Frames are converted on the global QThreadPool ahead of the upload, at most prepareAhead() frames are kept in
+ * memory. Frames are sent one at a time through the transfer engine as they're ready.
+ */
+class LIBQATEMCONTROLSHARED_EXPORT QAtemClipUploader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QAtemClipUploader(QAtemConnection *connection, QObject *parent = nullptr);
+    ~QAtemClipUploader();
+
+    /// How images that don't match the frame size are scaled. Defaults to QAtem::CropImage.
+    void setScaleMode(QAtem::ImageScaleMode mode) { m_scaleMode = mode; }
+    QAtem::ImageScaleMode scaleMode() const { return m_scaleMode; }
+
+    /// Number of frames converted ahead of the frame being uploaded. Defaults to the ideal thread count.
+    void setPrepareAhead(int frames) { m_prepareAhead = qMax(1, frames); }
+    int prepareAhead() const { return m_prepareAhead; }
+
+    /**
+     * Upload the images in @p fileNames as the frames of media pool clip @p clip (0 or 1) and name the clip @p name.
+     * @returns false if an upload is already running or the clip is too small for the sequence
+     */
+    bool upload(quint8 clip, const QStringList &fileNames, const QString &name);
+    /// Stop the upload after the frame in progress
+    void cancel();
+
+    bool isRunning() const { return m_state != Idle; }
+
+protected slots:
+    void handleGetLockStateChanged(quint8 storeId, bool state);
+    void handleMediaLockStateChanged(quint8 id, bool state);
+    void handleDataTransferFinished(quint16 transferId);
+    void handleDataTransferFailed(quint16 transferId);
+    void handleDisconnected();
+    void handleConnected();
+
+    void uploadNext();
+
+private:
+    enum State
+    {
+        Idle,
+        AquiringLock,
+        Uploading
+    };
+
+    void fillPrepareQueue();
+    void finish(bool success);
+
+    QAtemConnection *m_connection;
+    QAtem::ImageScaleMode m_scaleMode;
+    int m_prepareAhead;
+    State m_state;
+
+    quint8 m_clip;
+    QString m_name;
+    QStringList m_fileNames;
+
+    QQueue<QFuture<QByteArray> > m_frames;
+    QFutureWatcher<QByteArray> m_frameWatcher;
+    int m_nextPrepare;
+    int m_currentFrame;
+    quint16 m_transferId;
+    bool m_locked;
+    bool m_canceled;
+
+signals:
+    void frameUploaded(int frame, int frameCount);
+    void uploadFinished(bool success);
+    void uploadError(const QString &errorString);
+};
+
+#endif // QATEMCLIPUPLOADER_H
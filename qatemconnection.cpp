@@ -19,19 +19,25 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include "qatemmixeffect.h"
 #include "qatemcameracontrol.h"
 #include "qatemdownstreamkey.h"
+#include "qatemimageconverter.h"
+#include "qatemaudiolevelsubscription.h"
 
 #include <QDebug>
 #include <QTimer>
 #include <QHostAddress>
 #include <QImage>
-#include <QPainter>
 #include <QCryptographicHash>
 #include <QThread>
+#include <QtEndian>
+#include <QtConcurrentRun>
 
 #include <math.h>
 
 #define SIZE_OF_HEADER 0x0c
 
+/// Marks a run in run length encoded frame data, it is followed by a 64 bit repeat count and the 8 byte block to repeat
+static const quint64 RLE_MARKER = Q_UINT64_C(0xfefefefefefefefe);
+
 /// Hack to use QThread::usleep in Qt 4.x
 class QAtemThread : public QThread
 {
@@ -47,6 +53,20 @@ QAtemConnection::QAtemConnection(QObject* parent)
     connect(m_connectionTimer, SIGNAL(timeout()),
             this, SLOT(handleConnectionTimeout()));
 
+    m_coalesceTimer = new QTimer(this);
+    m_coalesceTimer->setSingleShot(true);
+    connect(m_coalesceTimer, SIGNAL(timeout()),
+            this, SLOT(sendCoalescedCommands()));
+    m_defaultCommandRate = 30;
+    m_optimisticUpdatesEnabled = false;
+    m_optimisticTimeout = 1000;
+    m_pendingUpdateTimer = new QTimer(this);
+    m_pendingUpdateTimer->setInterval(50);
+    connect(m_pendingUpdateTimer, SIGNAL(timeout()),
+            this, SLOT(expirePendingUpdates()));
+    m_roundTripTime = -1;
+    m_commandClock.start();
+
     m_port = 9910;
     m_packetCounter = 0;
     m_isInitialized = false;
@@ -82,11 +102,27 @@ QAtemConnection::QAtemConnection(QObject* parent)
     m_hasAudioMonitor = false;
 
     m_transferActive = false;
+    m_transferDownload = false;
+    m_transferCompressed = false;
+    m_transferAudio = false;
+    m_transferCompressionEnabled = true;
+    m_transferInterrupted = false;
+    m_transferLockRequested = false;
+    m_transferDescriptionSent = false;
+    m_transferOffset = 0;
+    m_transferSize = 0;
+    m_transferSent = 0;
+    m_transferAcked = 0;
+    m_throughputWindowStart = 0;
+    m_throughputWindowBytes = 0;
+    m_transferDeviceRemaining = 0;
     m_transferStoreId = 0;
     m_transferIndex = 0;
     m_transferId = 0;
     m_lastTransferId = 0;
 
+    m_lockTimer.start();
+
     initCommandSlotHash();
 
     m_cameraControl = new QAtemCameraControl(this);
@@ -140,6 +176,12 @@ void QAtemConnection::connectToSwitcher(const QHostAddress &address, int connect
 
     m_socket->bind();
     m_packetCounter = 0;
+    m_coalescedCommands.clear();
+    m_coalesceTimer->stop();
+    m_pendingUpdates.clear();
+    m_pendingUpdateTimer->stop();
+    m_sentPackets.clear();
+    failTransactions();
     m_isInitialized = false;
     m_currentUid = 0x1337; // Just a random UID, we'll get a new one from the server eventually
     memset(&m_topology, 0, sizeof(m_topology));
@@ -158,6 +200,12 @@ void QAtemConnection::disconnectFromSwitcher()
     delete m_socket;
     m_socket = nullptr;
     m_connectionTimer->stop();
+
+    // Only a lost connection keeps the transfer to restart it, nothing reconnects after an explicit disconnect
+    if(m_transferActive)
+    {
+        failTransfer();
+    }
 }
 
 void QAtemConnection::handleSocketData()
@@ -180,6 +228,12 @@ void QAtemConnection::handleSocketData()
         QAtemConnection::CommandHeader header = parseCommandHeader(datagram);
         m_currentUid = header.uid;
 
+        if(header.bitmask & Cmd_Ack)
+        {
+            handleTransferAck(header.ackId);
+            handleCommandAck(header.ackId);
+        }
+
         if(header.bitmask & Cmd_HelloPacket)
         {
             m_isInitialized = false;
@@ -316,8 +370,16 @@ void QAtemConnection::parsePayLoad(const QByteArray& datagram)
                 }
             }
 
+            int index = payload.size() > 6 ? static_cast<quint8>(payload.at(6)) : -1;
+
             foreach(const ObjectSlot &objslot, m_commandSlotHash.values(cmd))
             {
+                // Per instance commands only go to the ME or keyer they are for
+                if(objslot.index != -1 && objslot.index != index)
+                {
+                    continue;
+                }
+
                 QMetaObject::invokeMethod(objslot.object, objslot.slot, Qt::QueuedConnection, Q_ARG(QByteArray, payload));
             }
         }
@@ -366,6 +428,11 @@ void QAtemConnection::setInitialized(bool state)
 void QAtemConnection::emitConnectedSignal()
 {
     emit connected();
+
+    if(m_transferInterrupted && m_isInitialized)
+    {
+        resumeTransfer();
+    }
 }
 
 bool QAtemConnection::sendDatagram(const QByteArray& datagram)
@@ -381,23 +448,416 @@ bool QAtemConnection::sendDatagram(const QByteArray& datagram)
 }
 
 bool QAtemConnection::sendCommand(const QByteArray& cmd, const QByteArray& payload)
+{
+    if(m_transaction)
+    {
+        m_transaction->addCommand(transactionKey(cmd, payload), cmd, payload);
+        return true;
+    }
+
+    return sendCommandImmediately(cmd, payload);
+}
+
+bool QAtemConnection::sendCommandImmediately(const QByteArray &cmd, const QByteArray &payload)
+{
+    return sendPacket(encodeCommand(cmd, payload));
+}
+
+QVector<quint16> QAtemConnection::sendCommands(const QVector<QPair<QByteArray, QByteArray> > &commands)
+{
+    // Keep the datagrams within the size the switcher uses itself so they aren't fragmented
+    static const int maxDatagramSize = 1416;
+
+    QVector<quint16> packetIds;
+    QByteArray packet;
+
+    for(int i = 0; i < commands.size(); ++i)
+    {
+        QByteArray command = encodeCommand(commands.at(i).first, commands.at(i).second);
+
+        if(!packet.isEmpty() && (SIZE_OF_HEADER + packet.size() + command.size()) > maxDatagramSize)
+        {
+            sendPacket(packet);
+            packetIds.append(m_packetCounter);
+            packet.clear();
+        }
+
+        packet.append(command);
+    }
+
+    if(!packet.isEmpty())
+    {
+        sendPacket(packet);
+        packetIds.append(m_packetCounter);
+    }
+
+    return packetIds;
+}
+
+bool QAtemConnection::sendPacket(const QByteArray &commands)
+{
+    QByteArray datagram = createCommandHeader(Cmd_AckRequest, static_cast<quint16>(commands.size()), m_currentUid, 0x0);
+    datagram.append(commands);
+
+    m_sentPackets.enqueue(qMakePair(m_packetCounter, m_commandClock.elapsed()));
+
+    if(m_sentPackets.size() > 256)
+    {
+        m_sentPackets.dequeue();
+    }
+
+    return sendDatagram(datagram);
+}
+
+QByteArray QAtemConnection::encodeCommand(const QByteArray &cmd, const QByteArray &payload)
 {
     QAtem::U16_U8 size;
 
     size.u16 = static_cast<quint16>(payload.size() + cmd.size() + 4);
 
-    QByteArray datagram = createCommandHeader(Cmd_AckRequest, size.u16, m_currentUid, 0x0);
+    QByteArray command;
+    command.reserve(size.u16);
 
-    datagram.append(static_cast<char>(size.u8[1]));
-    datagram.append(static_cast<char>(size.u8[0]));
+    command.append(static_cast<char>(size.u8[1]));
+    command.append(static_cast<char>(size.u8[0]));
 
-    datagram.append('\0');
-    datagram.append('\0');
+    command.append('\0');
+    command.append('\0');
 
-    datagram.append(cmd);
-    datagram.append(payload);
+    command.append(cmd);
+    command.append(payload);
 
-    return sendDatagram(datagram);
+    return command;
+}
+
+QAtemTransaction *QAtemConnection::beginTransaction()
+{
+    if(!m_transaction)
+    {
+        m_transaction = new QAtemTransaction(this);
+    }
+
+    return m_transaction;
+}
+
+void QAtemConnection::failTransactions()
+{
+    QList<QPointer<QAtemTransaction> > transactions = m_committedTransactions;
+    m_committedTransactions.clear();
+
+    foreach(const QPointer<QAtemTransaction> &transaction, transactions)
+    {
+        if(transaction)
+        {
+            transaction->finish(QAtemTransaction::Failed);
+        }
+    }
+}
+
+void QAtemConnection::sendCoalescedCommand(const QByteArray &cmd, const QByteArray &payload, int keySize)
+{
+    QByteArray key = cmd + payload.left(keySize);
+
+    if(m_transaction)
+    {
+        // The transaction sends a newer value, drop the one waiting for the rate limit
+        QHash<QByteArray, CoalescedCommand>::iterator it = m_coalescedCommands.find(key);
+
+        if(it != m_coalescedCommands.end())
+        {
+            it->pending = false;
+        }
+
+        m_transaction->addCommand(key, cmd, payload);
+        return;
+    }
+
+    CoalescedCommand &command = m_coalescedCommands[key];
+
+    if(command.cmd.isEmpty())
+    {
+        command.cmd = cmd;
+        command.sentTime = m_commandClock.elapsed() - 1000;
+    }
+
+    command.payload = payload;
+    command.pending = true;
+
+    sendCoalescedCommands();
+}
+
+void QAtemConnection::dropQueuedCommand(const QByteArray &cmd, const QByteArray &payload)
+{
+    QByteArray key = transactionKey(cmd, payload);
+    QHash<QByteArray, CoalescedCommand>::iterator it = m_coalescedCommands.find(key);
+
+    // A value the switcher hasn't reported yet is waiting for the rate limit or an ack, it would be the last one
+    // applied, so send the reported value again after it
+    if(it != m_coalescedCommands.end() && (it->pending || it->inFlight))
+    {
+        if(m_transaction)
+        {
+            it->pending = false;
+            m_transaction->addCommand(key, cmd, payload);
+        }
+        else
+        {
+            it->payload = payload;
+            it->pending = true;
+            sendCoalescedCommands();
+        }
+
+        return;
+    }
+
+    if(m_transaction)
+    {
+        m_transaction->removeCommand(key);
+    }
+}
+
+void QAtemConnection::dropCoalescedCommands(const QByteArray &cmd, int offset, const QByteArray &indexes)
+{
+    QMutableHashIterator<QByteArray, CoalescedCommand> it(m_coalescedCommands);
+
+    while(it.hasNext())
+    {
+        CoalescedCommand &command = it.next().value();
+
+        if(command.cmd == cmd && command.payload.mid(offset, indexes.size()) == indexes)
+        {
+            command.pending = false;
+        }
+    }
+}
+
+QByteArray QAtemConnection::transactionKey(const QByteArray &cmd, const QByteArray &payload)
+{
+    // Number of leading payload bytes, the mask and the indexes, that identify the parameter a command sets
+    static QHash<QByteArray, int> keySizes;
+
+    if(keySizes.isEmpty())
+    {
+        keySizes.insert("CPgI", 1);
+        keySizes.insert("CPvI", 1);
+        keySizes.insert("CTPs", 1);
+        keySizes.insert("CTPr", 1);
+        keySizes.insert("CTTp", 2);
+        keySizes.insert("FtbC", 2);
+        keySizes.insert("CTMx", 1);
+        keySizes.insert("CTDp", 2);
+        keySizes.insert("CTWp", 3);
+        keySizes.insert("CTDv", 3);
+        keySizes.insert("CTSt", 3);
+        keySizes.insert("CKOn", 2);
+        keySizes.insert("CKTp", 3);
+        keySizes.insert("CKeF", 2);
+        keySizes.insert("CKeC", 2);
+        keySizes.insert("CKMs", 3);
+        keySizes.insert("CKLm", 3);
+        keySizes.insert("CKCk", 3);
+        keySizes.insert("CKPt", 3);
+        keySizes.insert("CKDV", 6);
+        keySizes.insert("CDsL", 1);
+        keySizes.insert("CDsT", 1);
+        keySizes.insert("CDsF", 1);
+        keySizes.insert("CDsC", 1);
+        keySizes.insert("CDsR", 1);
+        keySizes.insert("CDsG", 2);
+        keySizes.insert("CDsM", 2);
+        keySizes.insert("CClV", 2);
+        keySizes.insert("CAuS", 2);
+        keySizes.insert("CInL", 4);
+        keySizes.insert("CVdM", 0);
+        keySizes.insert("CDcO", 0);
+        keySizes.insert("CMPS", 0);
+        keySizes.insert("CMvP", 2);
+        keySizes.insert("CMvI", 2);
+        keySizes.insert("MPSS", 2);
+        keySizes.insert("CAMI", 4);
+        keySizes.insert("CAMM", 1);
+        keySizes.insert("CAMm", 1);
+        keySizes.insert("CCmd", 3);
+        keySizes.insert("MRCP", 1);
+        keySizes.insert("CMPr", 4);
+    }
+
+    QHash<QByteArray, int>::const_iterator it = keySizes.constFind(cmd);
+
+    if(it == keySizes.constEnd())
+    {
+        return cmd + payload;
+    }
+
+    return cmd + payload.left(it.value());
+}
+
+void QAtemConnection::sendCoalescedCommands()
+{
+    // Acks that never arrive would block a parameter forever
+    static const qint64 ackTimeout = 250;
+
+    qint64 now = m_commandClock.elapsed();
+    qint64 next = -1;
+    QMutableHashIterator<QByteArray, CoalescedCommand> it(m_coalescedCommands);
+
+    while(it.hasNext())
+    {
+        CoalescedCommand &command = it.next().value();
+        int rate = commandRate(command.cmd);
+        qint64 interval = rate > 0 ? 1000 / rate : 0;
+
+        if(command.inFlight && (now - command.sentTime) >= ackTimeout)
+        {
+            command.inFlight = false;
+        }
+
+        if(!command.pending)
+        {
+            if(!command.inFlight && (now - command.sentTime) >= interval)
+            {
+                it.remove();
+            }
+
+            continue;
+        }
+
+        qint64 due = command.inFlight ? command.sentTime + ackTimeout : command.sentTime + interval;
+
+        if(!command.inFlight && due <= now)
+        {
+            sendCommandImmediately(command.cmd, command.payload);
+            command.packetId = m_packetCounter;
+            command.inFlight = true;
+            command.pending = false;
+            command.sentTime = now;
+            continue;
+        }
+
+        next = next < 0 ? due : qMin(next, due);
+    }
+
+    if(next >= 0)
+    {
+        m_coalesceTimer->start(static_cast<int>(qMax(next - now, static_cast<qint64>(1))));
+    }
+}
+
+void QAtemConnection::addPendingUpdate(const QByteArray &key, QObject *object, const QVariant &expected, const QVariant &current)
+{
+    QHash<QByteArray, PendingUpdate>::iterator it = m_pendingUpdates.find(key);
+
+    if(it == m_pendingUpdates.end())
+    {
+        it = m_pendingUpdates.insert(key, PendingUpdate());
+        it->confirmed = current;
+    }
+
+    it->object = object;
+    it->expected = expected;
+    it->deadline = m_commandClock.elapsed() + m_optimisticTimeout;
+
+    if(!m_pendingUpdateTimer->isActive())
+    {
+        m_pendingUpdateTimer->start();
+    }
+}
+
+bool QAtemConnection::reconcileUpdate(const QByteArray &key, const QVariant &reported)
+{
+    QHash<QByteArray, PendingUpdate>::iterator it = m_pendingUpdates.find(key);
+
+    if(it == m_pendingUpdates.end())
+    {
+        return true;
+    }
+
+    if(reported == it->expected)
+    {
+        m_pendingUpdates.erase(it);
+        return true;
+    }
+
+    // An older state, keep the optimistic one until the switcher catches up or the update times out
+    it->confirmed = reported;
+    return false;
+}
+
+void QAtemConnection::expirePendingUpdates()
+{
+    qint64 now = m_commandClock.elapsed();
+    QMutableHashIterator<QByteArray, PendingUpdate> it(m_pendingUpdates);
+
+    while(it.hasNext())
+    {
+        it.next();
+
+        if(it.value().deadline > now)
+        {
+            continue;
+        }
+
+        QByteArray key = it.key();
+        PendingUpdate update = it.value();
+        it.remove();
+
+        if(update.object)
+        {
+            QMetaObject::invokeMethod(update.object, "rollbackUpdate", Q_ARG(QByteArray, key), Q_ARG(QVariant, update.confirmed));
+        }
+    }
+
+    if(m_pendingUpdates.isEmpty())
+    {
+        m_pendingUpdateTimer->stop();
+    }
+}
+
+void QAtemConnection::handleCommandAck(quint16 packetId)
+{
+    qint64 now = m_commandClock.elapsed();
+
+    // Acks are cumulative, every packet up to and including packetId has been received
+    while(!m_sentPackets.isEmpty() && static_cast<quint16>(packetId - m_sentPackets.head().first) < 0x8000)
+    {
+        QPair<quint16, qint64> sent = m_sentPackets.dequeue();
+
+        if(sent.first == packetId)
+        {
+            float rtt = static_cast<float>(now - sent.second);
+            m_roundTripTime = m_roundTripTime < 0 ? rtt : (m_roundTripTime * 0.875f) + (rtt * 0.125f);
+        }
+    }
+
+    bool pending = false;
+    QMutableHashIterator<QByteArray, CoalescedCommand> it(m_coalescedCommands);
+
+    while(it.hasNext())
+    {
+        CoalescedCommand &command = it.next().value();
+
+        if(command.inFlight && static_cast<quint16>(packetId - command.packetId) < 0x8000)
+        {
+            command.inFlight = false;
+        }
+
+        pending |= command.pending;
+    }
+
+    if(pending)
+    {
+        sendCoalescedCommands();
+    }
+
+    QList<QPointer<QAtemTransaction> > transactions = m_committedTransactions;
+
+    foreach(const QPointer<QAtemTransaction> &transaction, transactions)
+    {
+        if(transaction)
+        {
+            transaction->handleAck(packetId);
+        }
+    }
 }
 
 void QAtemConnection::handleError(QAbstractSocket::SocketError)
@@ -409,6 +869,8 @@ void QAtemConnection::handleError(QAbstractSocket::SocketError)
     delete m_socket;
     m_socket = nullptr;
     m_isInitialized = false;
+    interruptTransfer();
+    failTransactions();
 
     emit disconnected();
 }
@@ -419,6 +881,8 @@ void QAtemConnection::handleConnectionTimeout()
     m_socket = nullptr;
     m_isInitialized = false;
     m_connectionTimer->stop();
+    interruptTransfer();
+    failTransactions();
     emit socketError(tr("The switcher connection timed out"));
     emit disconnected();
 }
@@ -441,11 +905,6 @@ void QAtemConnection::clearSettings()
 
 void QAtemConnection::setColorGeneratorColor(quint8 generator, const QColor& color)
 {
-    if(color == m_colorGeneratorColors.value(generator))
-    {
-        return;
-    }
-
     QByteArray cmd("CClV");
     QByteArray payload(8, '\0');
 
@@ -463,6 +922,12 @@ void QAtemConnection::setColorGeneratorColor(quint8 generator, const QColor& col
     payload[6] = static_cast<char>(l.u8[1]);
     payload[7] = static_cast<char>(l.u8[0]);
 
+    if(color == m_colorGeneratorColors.value(generator))
+    {
+        dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     sendCommand(cmd, payload);
 }
 
@@ -598,11 +1063,6 @@ quint16 QAtemConnection::auxSource(quint8 aux) const
 
 void QAtemConnection::setAuxSource(quint8 aux, quint16 source)
 {
-    if(source == m_auxSource.value(aux))
-    {
-        return;
-    }
-
     quint8 payloadsize = 4;
 
     if(m_majorversion == 1 || (m_majorversion == 2 && m_minorversion < 16))
@@ -620,16 +1080,17 @@ void QAtemConnection::setAuxSource(quint8 aux, quint16 source)
     payload[2] = static_cast<char>(val.u8[1]);
     payload[3] = static_cast<char>(val.u8[0]);
 
+    if(source == m_auxSource.value(aux))
+    {
+        dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     sendCommand(cmd, payload);
 }
 
 void QAtemConnection::setInputType(quint16 input, quint8 type)
 {
-    if(type == m_inputInfos.value(input).externalType)
-    {
-        return;
-    }
-
     QByteArray cmd("CInL");
     QByteArray payload(32, 0x0);
     QAtem::U16_U8 val;
@@ -640,16 +1101,17 @@ void QAtemConnection::setInputType(quint16 input, quint8 type)
     payload[3] = static_cast<char>(val.u8[0]);
     payload[29] = static_cast<char>(type);
 
+    if(type == m_inputInfos.value(input).externalType)
+    {
+        dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     sendCommand(cmd, payload);
 }
 
 void QAtemConnection::setInputLongName(quint16 input, const QString &name)
 {
-    if(name == m_inputInfos.value(input).longText)
-    {
-        return;
-    }
-
     QByteArray cmd("CInL");
     QByteArray payload(32, 0x0);
     QByteArray namearray = name.toLatin1();
@@ -663,16 +1125,17 @@ void QAtemConnection::setInputLongName(quint16 input, const QString &name)
     payload.replace(4, 20, namearray);
     payload[28] = static_cast<char>(0xff);
 
+    if(name == m_inputInfos.value(input).longText)
+    {
+        dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     sendCommand(cmd, payload);
 }
 
 void QAtemConnection::setInputShortName(quint16 input, const QString &name)
 {
-    if(name == m_inputInfos.value(input).shortText)
-    {
-        return;
-    }
-
     QByteArray cmd("CInL");
     QByteArray payload(32, 0x0);
     QByteArray namearray = name.toLatin1();
@@ -685,36 +1148,44 @@ void QAtemConnection::setInputShortName(quint16 input, const QString &name)
     payload[3] = static_cast<char>(val.u8[0]);
     payload.replace(24, 4, namearray);
 
+    if(name == m_inputInfos.value(input).shortText)
+    {
+        dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     sendCommand(cmd, payload);
 }
 
 void QAtemConnection::setVideoFormat(quint8 format)
 {
-    if(format == m_videoFormat)
-    {
-        return;
-    }
-
     QByteArray cmd("CVdM");
     QByteArray payload(4, 0x0);
 
     payload[0] = static_cast<char>(format);
 
+    if(format == m_videoFormat)
+    {
+        dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     sendCommand(cmd, payload);
 }
 
 void QAtemConnection::setVideoDownConvertType(quint8 type)
 {
-    if (type == m_videoDownConvertType)
-    {
-        return;
-    }
-
     QByteArray cmd("CDcO");
     QByteArray payload(4, 0x0);
 
     payload[0] = static_cast<char>(type);
 
+    if(type == m_videoDownConvertType)
+    {
+        dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     sendCommand(cmd, payload);
 }
 
@@ -731,6 +1202,24 @@ void QAtemConnection::setMediaPoolClipSplit(quint16 size)
     sendCommand(cmd, payload);
 }
 
+void QAtemConnection::setMediaPoolClip(quint8 clip, const QString &name, quint16 frameCount)
+{
+    QByteArray cmd("SMPC");
+    QByteArray payload(68, 0x0);
+    QByteArray namearray = name.toUtf8();
+    namearray.resize(64);
+    QAtem::U16_U8 val;
+
+    payload[0] = 0x03; // Name and frame count
+    payload[1] = static_cast<char>(clip);
+    payload.replace(2, 64, namearray);
+    val.u16 = frameCount;
+    payload[66] = static_cast<char>(val.u8[1]);
+    payload[67] = static_cast<char>(val.u8[0]);
+
+    sendCommand(cmd, payload);
+}
+
 void QAtemConnection::setMultiViewLayout(quint8 multiView, quint8 layout)
 {
     QByteArray cmd("CMvP");
@@ -1076,7 +1565,7 @@ void QAtemConnection::setAudioInputBalance(quint16 index, float balance)
     payload[8] = static_cast<char>(val.u8[1]);
     payload[9] = static_cast<char>(val.u8[0]);
 
-    sendCommand(cmd, payload);
+    sendCoalescedCommand(cmd, payload, 4);
 }
 
 void QAtemConnection::setAudioInputGain(quint16 index, float gain)
@@ -1093,7 +1582,7 @@ void QAtemConnection::setAudioInputGain(quint16 index, float gain)
     payload[6] = static_cast<char>(val.u8[1]);
     payload[7] = static_cast<char>(val.u8[0]);
 
-    sendCommand(cmd, payload);
+    sendCoalescedCommand(cmd, payload, 4);
 }
 
 void QAtemConnection::setAudioMasterOutputGain(float gain)
@@ -1107,68 +1596,109 @@ void QAtemConnection::setAudioMasterOutputGain(float gain)
     payload[2] = static_cast<char>(val.u8[1]);
     payload[3] = static_cast<char>(val.u8[0]);
 
-    sendCommand(cmd, payload);
+    sendCoalescedCommand(cmd, payload, 1);
 }
 
 void QAtemConnection::onAMLv(const QByteArray& payload)
 {
     // Audio mixer levels
-    QAtem::U16_U8 numInputs;
-    numInputs.u8[1] = static_cast<quint8>(payload.at(6));
-    numInputs.u8[0] = static_cast<quint8>(payload.at(7));
+    const uchar *data = reinterpret_cast<const uchar*>(payload.constData());
+    int numInputs = qFromBigEndian<quint16>(data + 6);
+    int offset = 43 + (numInputs * 2);
 
-    QAtem::U16_U8 val;
-    val.u8[1] = static_cast<quint8>(payload.at(11));
-    val.u8[0] = static_cast<quint8>(payload.at(12));
-    m_audioMasterOutputLevelLeft = convertToDecibel(val.u16);
-    val.u8[1] = static_cast<quint8>(payload.at(15));
-    val.u8[0] = static_cast<quint8>(payload.at(16));
-    m_audioMasterOutputLevelRight = convertToDecibel(val.u16);
-    val.u8[1] = static_cast<quint8>(payload.at(19));
-    val.u8[0] = static_cast<quint8>(payload.at(20));
-    m_audioMasterOutputPeakLeft = convertToDecibel(val.u16);
-    val.u8[1] = static_cast<quint8>(payload.at(23));
-    val.u8[0] = static_cast<quint8>(payload.at(24));
-    m_audioMasterOutputPeakRight = convertToDecibel(val.u16);
-    val.u8[1] = static_cast<quint8>(payload.at(27));
-    val.u8[0] = static_cast<quint8>(payload.at(28));
-    m_audioMonitorLevel = convertToDecibel(val.u16);
-
-    QList<quint16> idlist;
-
-    for(int i = 0; i < numInputs.u16; ++i)
-    {
-        val.u8[1] = static_cast<quint8>(payload.at(42 + (i * 2)));
-        val.u8[0] = static_cast<quint8>(payload.at(43 + (i * 2)));
-        idlist.append(val.u16);
-    }
-
-    int offset = 43 + ((numInputs.u16) * 2);
-
-    for(int i = 0; i < numInputs.u16; ++i)
-    {
-        quint16 index = idlist[i];
-        m_audioLevels[index].index = index;
-        val.u8[1] = static_cast<quint8>(payload.at(offset + (i * 16)));
-        val.u8[0] = static_cast<quint8>(payload.at(offset + 1 + (i * 16)));
-        m_audioLevels[index].left = convertToDecibel(val.u16);
-        val.u8[1] = static_cast<quint8>(payload.at(offset + 4 + (i * 16)));
-        val.u8[0] = static_cast<quint8>(payload.at(offset + 5 + (i * 16)));
-        m_audioLevels[index].right = convertToDecibel(val.u16);
-        val.u8[1] = static_cast<quint8>(payload.at(offset + 8 + (i * 16)));
-        val.u8[0] = static_cast<quint8>(payload.at(offset + 9 + (i * 16)));
-        m_audioLevels[index].peakLeft = convertToDecibel(val.u16);
-        val.u8[1] = static_cast<quint8>(payload.at(offset + 12 + (i * 16)));
-        val.u8[0] = static_cast<quint8>(payload.at(offset + 13 + (i * 16)));
-        m_audioLevels[index].peakRight = convertToDecibel(val.u16);
+    if(payload.size() < offset + (numInputs * 16) - 2)
+    {
+        return;
+    }
+
+    m_audioMasterOutputLevelLeft = convertToDecibel(qFromBigEndian<quint16>(data + 11));
+    m_audioMasterOutputLevelRight = convertToDecibel(qFromBigEndian<quint16>(data + 15));
+    m_audioMasterOutputPeakLeft = convertToDecibel(qFromBigEndian<quint16>(data + 19));
+    m_audioMasterOutputPeakRight = convertToDecibel(qFromBigEndian<quint16>(data + 23));
+    m_audioMonitorLevel = convertToDecibel(qFromBigEndian<quint16>(data + 27));
+
+    // The inputs rarely change, so only rebuild the index lookup when they do
+    bool idsChanged = m_audioLevelIds.size() != numInputs;
+
+    for(int i = 0; i < numInputs && !idsChanged; ++i)
+    {
+        idsChanged = m_audioLevelIds.at(i) != qFromBigEndian<quint16>(data + 42 + (i * 2));
+    }
+
+    if(idsChanged)
+    {
+        m_audioLevelIds.resize(numInputs);
+        m_audioLevels.resize(numInputs);
+        m_audioLevelSlots.clear();
+
+        for(int i = 0; i < numInputs; ++i)
+        {
+            quint16 index = qFromBigEndian<quint16>(data + 42 + (i * 2));
+            m_audioLevelIds[i] = index;
+            m_audioLevels[i].index = index;
+            m_audioLevelSlots.insert(index, i);
+        }
+    }
+
+    QAtem::AudioLevel *levels = m_audioLevels.data();
+    const uchar *input = data + offset;
+
+    for(int i = 0; i < numInputs; ++i, input += 16)
+    {
+        levels[i].left = convertToDecibel(qFromBigEndian<quint16>(input));
+        levels[i].right = convertToDecibel(qFromBigEndian<quint16>(input + 4));
+        levels[i].peakLeft = convertToDecibel(qFromBigEndian<quint16>(input + 8));
+        levels[i].peakRight = convertToDecibel(qFromBigEndian<quint16>(input + 12));
+    }
+
+    if(!m_audioLevelSubscriptions.isEmpty())
+    {
+        QAtem::AudioLevel master;
+        master.index = 0;
+        master.left = m_audioMasterOutputLevelLeft;
+        master.right = m_audioMasterOutputLevelRight;
+        master.peakLeft = m_audioMasterOutputPeakLeft;
+        master.peakRight = m_audioMasterOutputPeakRight;
+
+        foreach(QAtemAudioLevelSubscription *subscription, m_audioLevelSubscriptions)
+        {
+            subscription->addLevels(m_audioLevels, master, m_audioMonitorLevel);
+        }
     }
 
     emit audioLevelsChanged();
 }
 
+QAtem::AudioLevel QAtemConnection::audioLevel(quint16 index) const
+{
+    int slot = m_audioLevelSlots.value(index, -1);
+
+    if(slot < 0)
+    {
+        return QAtem::AudioLevel();
+    }
+
+    return m_audioLevels.at(slot);
+}
+
+/// dB value of every 16 bit level, built the first time it's needed
+struct DecibelTable
+{
+    DecibelTable()
+    {
+        for(int i = 0; i < 65536; ++i)
+        {
+            values[i] = log10(static_cast<float>(i) / 32768.0f) * 20.0f;
+        }
+    }
+
+    float values[65536];
+};
+
 float QAtemConnection::convertToDecibel(quint16 level)
 {
-    return log10(static_cast<float>(level) / 32768.0f) * 20.0f;
+    static const DecibelTable table;
+    return table.values[level];
 }
 
 
@@ -1244,17 +1774,18 @@ void QAtemConnection::onAMmO(const QByteArray& payload)
 
 void QAtemConnection::setAudioMonitorEnabled(bool enabled)
 {
-    if (enabled == m_audioMonitorEnabled)
-    {
-        return;
-    }
-
     QByteArray cmd("CAMm");
     QByteArray payload(12, 0x0);
 
     payload[0] = 0x01;
     payload[1] = static_cast<char>(enabled);
 
+    if(enabled == m_audioMonitorEnabled)
+    {
+        dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     sendCommand(cmd, payload);
 }
 
@@ -1269,7 +1800,7 @@ void QAtemConnection::setAudioMonitorGain(float gain)
     payload[2] = static_cast<char>(val.u8[1]);
     payload[3] = static_cast<char>(val.u8[0]);
 
-    sendCommand(cmd, payload);
+    sendCoalescedCommand(cmd, payload, 1);
 }
 
 void QAtemConnection::setAudioMonitorMuted(bool muted)
@@ -1320,7 +1851,7 @@ void QAtemConnection::onAMMO(const QByteArray& payload)
     emit audioMasterOutputGainChanged(m_audioMasterOutputGain);
 }
 
-bool QAtemConnection::aquireMediaLock(quint8 id, quint8 index)
+bool QAtemConnection::aquireMediaLock(quint8 id, quint16 index)
 {
     if(m_mediaLocks.value(id))
     {
@@ -1330,11 +1861,15 @@ bool QAtemConnection::aquireMediaLock(quint8 id, quint8 index)
     QByteArray cmd("PLCK");
     QByteArray payload(8, 0x0);
 
+    QAtem::U16_U8 val;
+    val.u16 = index;
     payload[1] = static_cast<char>(id);
-    payload[3] = static_cast<char>(index);
+    payload[2] = static_cast<char>(val.u8[1]);
+    payload[3] = static_cast<char>(val.u8[0]);
     payload[5] = 0x01;
 
-    sendCommand(cmd, payload);
+    sendCommandImmediately(cmd, payload);
+    m_lockRequestTimes.insert(id, m_lockTimer.elapsed());
     return true;
 }
 
@@ -1343,7 +1878,25 @@ void QAtemConnection::onLKST(const QByteArray& payload)
     quint8 id = static_cast<quint8>(payload.at(7));
     m_mediaLocks[id] = static_cast<quint8>(payload.at(8));
 
+    if(m_mediaLocks.value(id))
+    {
+        recordLockWait(id);
+    }
+
     emit mediaLockStateChanged(id, m_mediaLocks.value(id));
+
+    if(m_transferInterrupted && !m_transferDownload && id == m_transferStoreId)
+    {
+        if(m_mediaLocks.value(id) && m_transferLockRequested)
+        {
+            restartTransfer();
+        }
+        else if(!m_mediaLocks.value(id))
+        {
+            // The lock held by the lost session has been released
+            m_transferLockRequested = aquireMediaLock(m_transferStoreId, m_transferIndex);
+        }
+    }
 }
 
 void QAtemConnection::unlockMediaLock(quint8 id)
@@ -1353,10 +1906,10 @@ void QAtemConnection::unlockMediaLock(quint8 id)
 
     payload[1] = static_cast<char>(id);
 
-    sendCommand(cmd, payload);
+    sendCommandImmediately(cmd, payload);
 }
 
-quint16 QAtemConnection::sendDataToSwitcher(quint8 storeId, quint8 index, const QByteArray &name, const QByteArray &data)
+quint16 QAtemConnection::sendDataToSwitcher(quint8 storeId, quint16 index, const QByteArray &name, const QByteArray &data)
 {
     if (m_transferActive)
     {
@@ -1367,15 +1920,105 @@ quint16 QAtemConnection::sendDataToSwitcher(quint8 storeId, quint8 index, const
     m_transferIndex = index;
     m_transferName = name;
     m_transferData = data;
+    m_transferDevice = nullptr;
+    m_transferDeviceRemaining = 0;
+    m_transferActive = true;
+    m_transferDownload = false;
+    m_transferCompressed = false;
+    m_transferAudio = false;
     m_lastTransferId++;
     m_transferId = m_lastTransferId;
     m_transferHash = QCryptographicHash::hash(data, QCryptographicHash::Md5);
 
+    if(m_transferCompressionEnabled && storeId != 0xff) // Only still and clip frames can be run length encoded
+    {
+        QByteArray compressed = compressRLE(data);
+
+        if(compressed.size() < data.size())
+        {
+            m_transferData = compressed;
+            m_transferCompressed = true;
+        }
+    }
+
+    m_transferSize = m_transferData.size();
+    resetUpload();
+    startTransferTelemetry();
     initDownloadToSwitcher();
 
     return m_transferId;
 }
 
+quint16 QAtemConnection::sendDataToSwitcher(quint8 storeId, quint16 index, const QByteArray &name, QIODevice *device, qint64 size, const QByteArray &hash)
+{
+    return startDeviceTransfer(storeId, index, name, device, size, hash, false);
+}
+
+quint16 QAtemConnection::sendClipAudioToSwitcher(quint8 clip, const QByteArray &name, QIODevice *device, qint64 size, const QByteArray &hash)
+{
+    return startDeviceTransfer(clipStoreId(clip), 0, name, device, size, hash, true);
+}
+
+quint16 QAtemConnection::startDeviceTransfer(quint8 storeId, quint16 index, const QByteArray &name, QIODevice *device, qint64 size,
+                                             const QByteArray &hash, bool audio)
+{
+    if (m_transferActive || !device || !device->isReadable())
+    {
+        return 0;
+    }
+
+    m_transferStoreId = storeId;
+    m_transferIndex = index;
+    m_transferName = name;
+    m_transferData.clear();
+    m_transferDevice = device;
+    m_transferDeviceRemaining = size;
+    m_transferActive = true;
+    m_transferDownload = false;
+    m_transferCompressed = false;
+    m_transferAudio = audio;
+    m_lastTransferId++;
+    m_transferId = m_lastTransferId;
+    m_transferHash = hash;
+
+    m_transferSize = size;
+    resetUpload();
+    startTransferTelemetry();
+    initDownloadToSwitcher();
+
+    return m_transferId;
+}
+
+void QAtemConnection::readTransferDevice()
+{
+    if(!m_transferDevice)
+    {
+        if(m_transferDeviceRemaining > 0)
+        {
+            qWarning() << "Transfer device deleted with" << m_transferDeviceRemaining << "bytes left";
+            m_transferDeviceRemaining = 0;
+        }
+
+        return;
+    }
+
+    // Keep a few credit windows worth of data buffered
+    QByteArray data = m_transferDevice->read(qMin(m_transferDeviceRemaining, static_cast<qint64>(1392 * 64)));
+
+    if(data.isEmpty())
+    {
+        qWarning() << "Transfer device ended with" << m_transferDeviceRemaining << "bytes left:" << m_transferDevice->errorString();
+        m_transferDeviceRemaining = 0;
+        return;
+    }
+
+    m_transferDeviceRemaining -= data.size();
+    // Drop the part of the buffer that has already been sent
+    m_transferData.remove(0, m_transferOffset);
+    m_transferOffset = 0;
+    m_transferData.append(data);
+}
+
 void QAtemConnection::initDownloadToSwitcher()
 {
     QByteArray cmd("FTSD");
@@ -1386,16 +2029,28 @@ void QAtemConnection::initDownloadToSwitcher()
     payload[0] = static_cast<char>(id.u8[1]);
     payload[1] = static_cast<char>(id.u8[0]);
     payload[2] = static_cast<char>(m_transferStoreId);
-    payload[7] = static_cast<char>(m_transferIndex);
+    QAtem::U16_U8 index;
+    index.u16 = m_transferIndex;
+    payload[6] = static_cast<char>(index.u8[1]);
+    payload[7] = static_cast<char>(index.u8[0]);
     QAtem::U32_U8 val;
-    val.u32 = static_cast<quint32>(m_transferData.size());
+    val.u32 = static_cast<quint32>(m_transferSize);
     payload[8] = static_cast<char>(val.u8[3]);
     payload[9] = static_cast<char>(val.u8[2]);
     payload[10] = static_cast<char>(val.u8[1]);
     payload[11] = static_cast<char>(val.u8[0]);
-    payload[13] = 0x01; // 0x01 == write, 0x02 == Clear
 
-    sendCommand(cmd, payload);
+    if(m_transferAudio)
+    {
+        payload[12] = 0x01; // 0x0100 == Write clip audio
+    }
+    else
+    {
+        payload[12] = m_transferCompressed ? 0x01 : 0x00; // 0x01 == Run length encoded
+        payload[13] = 0x01; // 0x01 == write, 0x02 == Clear
+    }
+
+    sendCommandImmediately(cmd, payload);
 }
 
 void QAtemConnection::onFTCD(const QByteArray& payload)
@@ -1407,6 +2062,9 @@ void QAtemConnection::onFTCD(const QByteArray& payload)
 
     if(id.u16 == m_transferId)
     {
+        m_transferTelemetry.creditWindows++;
+        m_transferTelemetry.creditedChunks += count;
+        m_transferTelemetry.lastCreditWindow = count;
         flushTransferBuffer(count);
     }
 }
@@ -1415,22 +2073,250 @@ void QAtemConnection::flushTransferBuffer(quint8 count)
 {
     int i = 0;
 
-    while(!m_transferData.isEmpty() && i < count && m_socket)
+    while(i < count && m_socket)
     {
-        QByteArray data = m_transferData.left(1392);
-        m_transferData = m_transferData.remove(0, data.size());
+        if((m_transferData.size() - m_transferOffset) < 1392 && m_transferDeviceRemaining > 0)
+        {
+            readTransferDevice();
+        }
+
+        if(m_transferOffset >= m_transferData.size())
+        {
+            break;
+        }
+
+        // The buffer is kept intact so the transfer can be restarted if the connection is lost
+        QByteArray data = m_transferData.mid(m_transferOffset, 1392);
+        m_transferOffset += data.size();
+        m_transferSent += data.size();
         sendData(m_transferId, data);
+
+        TransferChunk chunk;
+        chunk.packetId = m_packetCounter;
+        chunk.end = m_transferSent;
+        m_transferChunks.enqueue(chunk);
+
         m_socket->flush();
         QAtemThread::usleep(50); // QAtemThread is a hack to support Qt 4.x
         ++i;
     }
 
-    if(!m_transferActive)
+    if(!m_transferDescriptionSent && m_socket)
     {
         sendFileDescription();
+        m_transferDescriptionSent = true;
+    }
+
+    m_transferTelemetry.bytesSent = m_transferSent;
+    m_transferTelemetry.chunksInFlight = m_transferChunks.size();
+}
+
+void QAtemConnection::handleTransferAck(quint16 packetId)
+{
+    if(m_transferChunks.isEmpty())
+    {
+        return;
+    }
+
+    qint64 acked = m_transferAcked;
+
+    // Acks are cumulative, every chunk sent in a packet up to and including packetId has been received
+    while(!m_transferChunks.isEmpty() && static_cast<quint16>(packetId - m_transferChunks.head().packetId) < 0x8000)
+    {
+        m_transferAcked = m_transferChunks.dequeue().end;
     }
 
-    m_transferActive = !m_transferData.isEmpty();
+    m_transferTelemetry.chunksInFlight = m_transferChunks.size();
+
+    if(m_transferAcked != acked)
+    {
+        m_transferTelemetry.bytesAcked = m_transferAcked;
+        updateTransferTelemetry();
+    }
+}
+
+void QAtemConnection::startTransferTelemetry()
+{
+    m_transferTelemetry = QAtem::TransferTelemetry();
+    m_transferTelemetry.transferId = m_transferId;
+    m_transferTelemetry.download = m_transferDownload;
+    m_transferTelemetry.size = m_transferDownload ? 0 : m_transferSize;
+    // The lock is normally acquired just before the transfer is started
+    m_transferTelemetry.lockWaitTime = m_lockWaitTimes.take(m_transferStoreId);
+    m_transferTimer.start();
+    m_throughputWindowStart = 0;
+    m_throughputWindowBytes = 0;
+}
+
+void QAtemConnection::updateTransferTelemetry()
+{
+    QAtem::TransferTelemetry &t = m_transferTelemetry;
+    qint64 now = m_transferTimer.elapsed();
+    t.elapsedTime = now;
+
+    if(now > 0)
+    {
+        t.averageThroughput = t.bytesAcked * 1000.0 / now;
+    }
+
+    qint64 window = now - m_throughputWindowStart;
+
+    if(window >= 500)
+    {
+        t.currentThroughput = (t.bytesAcked - m_throughputWindowBytes) * 1000.0 / window;
+        m_throughputWindowStart = now;
+        m_throughputWindowBytes = t.bytesAcked;
+    }
+    else if(t.currentThroughput == 0.0)
+    {
+        t.currentThroughput = t.averageThroughput;
+    }
+
+    if(t.size > 0 && t.bytesAcked >= t.size)
+    {
+        t.estimatedTimeRemaining = 0;
+    }
+    else if(t.size > 0 && t.currentThroughput > 0)
+    {
+        t.estimatedTimeRemaining = static_cast<qint64>((t.size - t.bytesAcked) * 1000.0 / t.currentThroughput);
+    }
+    else
+    {
+        t.estimatedTimeRemaining = -1;
+    }
+
+    emit dataTransferProgress(t.transferId, t.bytesAcked, t.size);
+}
+
+void QAtemConnection::recordLockWait(quint8 id)
+{
+    if(!m_lockRequestTimes.contains(id))
+    {
+        return;
+    }
+
+    qint64 wait = m_lockTimer.elapsed() - m_lockRequestTimes.take(id);
+
+    if(m_transferInterrupted && id == m_transferStoreId)
+    {
+        m_transferTelemetry.lockWaitTime += wait;
+    }
+    else
+    {
+        m_lockWaitTimes.insert(id, wait);
+    }
+}
+
+void QAtemConnection::resetUpload()
+{
+    m_transferOffset = 0;
+    m_transferSent = 0;
+    m_transferAcked = 0;
+    m_transferChunks.clear();
+    m_transferDescriptionSent = false;
+    m_transferInterrupted = false;
+    m_transferLockRequested = false;
+}
+
+void QAtemConnection::interruptTransfer()
+{
+    if(!m_transferActive || m_transferInterrupted)
+    {
+        return;
+    }
+
+    m_transferInterrupted = true;
+    m_transferLockRequested = false;
+    m_transferChunks.clear();
+
+    emit dataTransferInterrupted(m_transferId);
+}
+
+void QAtemConnection::resumeTransfer()
+{
+    // The switcher doesn't keep the state of a transfer between sessions, so it has to be restarted under a new lock
+    if(m_transferDownload)
+    {
+        m_transferLockRequested = true;
+        aquireLock(m_transferStoreId);
+    }
+    else if(!m_mediaLocks.value(m_transferStoreId))
+    {
+        m_transferLockRequested = aquireMediaLock(m_transferStoreId, m_transferIndex);
+    }
+    // else wait for the switcher to release the lock held by the lost session, see onLKST()
+}
+
+void QAtemConnection::restartTransfer()
+{
+    if(m_transferDownload)
+    {
+        m_transferInterrupted = false;
+        m_transferLockRequested = false;
+        m_transferTelemetry.retransmittedBytes += m_transferData.size();
+        m_transferTelemetry.bytesAcked = 0;
+        m_transferData.clear();
+        requestData();
+    }
+    else
+    {
+        if(m_transferDevice)
+        {
+            if(!m_transferDevice->seek(0))
+            {
+                qWarning() << "Can't restart transfer, the transfer device isn't seekable";
+                failTransfer();
+                return;
+            }
+
+            m_transferData.clear();
+            m_transferDeviceRemaining = m_transferSize;
+        }
+        else if(m_transferSize > m_transferData.size())
+        {
+            qWarning() << "Can't restart transfer, the transfer device has been deleted";
+            failTransfer();
+            return;
+        }
+
+        m_transferTelemetry.retransmittedBytes += m_transferSent;
+        resetUpload();
+        m_transferTelemetry.bytesSent = 0;
+        m_transferTelemetry.bytesAcked = 0;
+        m_transferTelemetry.chunksInFlight = 0;
+        initDownloadToSwitcher();
+    }
+
+    m_transferTelemetry.restarts++;
+    emit dataTransferResumed(m_transferId);
+}
+
+void QAtemConnection::failTransfer()
+{
+    quint16 id = m_transferId;
+
+    m_transferActive = false;
+    m_transferDownload = false;
+    m_transferDevice = nullptr;
+    m_transferDeviceRemaining = 0;
+    resetUpload();
+
+    emit dataTransferFailed(id);
+}
+
+void QAtemConnection::cancelTransfer()
+{
+    if(!m_transferActive)
+    {
+        return;
+    }
+
+    m_transferActive = false;
+    m_transferDownload = false;
+    m_transferDevice = nullptr;
+    m_transferDeviceRemaining = 0;
+    m_transferData.clear();
+    resetUpload();
 }
 
 void QAtemConnection::sendData(quint16 id, const QByteArray &data)
@@ -1447,7 +2333,7 @@ void QAtemConnection::sendData(quint16 id, const QByteArray &data)
     payload[3] = static_cast<char>(val.u8[0]);
     payload.replace(4, data.size(), data);
 
-    sendCommand(cmd, payload);
+    sendCommandImmediately(cmd, payload);
 }
 
 void QAtemConnection::sendFileDescription()
@@ -1462,7 +2348,7 @@ void QAtemConnection::sendFileDescription()
     payload.replace(2, qMin(194, m_transferName.size()), m_transferName);
     payload.replace(194, 16, m_transferHash);
 
-    sendCommand(cmd, payload);
+    sendCommandImmediately(cmd, payload);
 }
 
 void QAtemConnection::onFTDC(const QByteArray& payload)
@@ -1471,10 +2357,27 @@ void QAtemConnection::onFTDC(const QByteArray& payload)
     id.u8[1] = static_cast<quint8>(payload.at(6));
     id.u8[0] = static_cast<quint8>(payload.at(7));
 
+    if(id.u16 == m_transferId && m_transferDownload)
+    {
+        if(m_transferStoreId == 0 || m_transferStoreId == 1)
+        {
+            m_transferData = decompressRLE(m_transferData);
+        }
+
+        m_transferActive = false;
+        m_transferDownload = false;
+    }
+    else if(id.u16 == m_transferId && m_transferActive)
+    {
+        m_transferActive = false;
+        m_transferDevice = nullptr;
+        m_transferChunks.clear();
+    }
+
     emit dataTransferFinished(id.u16);
 }
 
-quint16 QAtemConnection::getDataFromSwitcher(quint8 storeId, quint8 index)
+quint16 QAtemConnection::getDataFromSwitcher(quint8 storeId, quint16 index)
 {
     if (m_transferActive)
     {
@@ -1486,7 +2389,9 @@ quint16 QAtemConnection::getDataFromSwitcher(quint8 storeId, quint8 index)
     m_lastTransferId++;
     m_transferId = m_lastTransferId;
     m_transferActive = true;
+    m_transferDownload = true;
     m_transferData.clear();
+    startTransferTelemetry();
 
     requestData();
 
@@ -1503,14 +2408,17 @@ void QAtemConnection::requestData()
     payload[0] = static_cast<char>(id.u8[1]);
     payload[1] = static_cast<char>(id.u8[0]);
     payload[2] = static_cast<char>(m_transferStoreId);
-    payload[7] = static_cast<char>(m_transferIndex);
+    QAtem::U16_U8 index;
+    index.u16 = m_transferIndex;
+    payload[6] = static_cast<char>(index.u8[1]);
+    payload[7] = static_cast<char>(index.u8[0]);
 
     if(m_transferStoreId == 0xff) // Macros
     {
         payload[8] = 0x03;
     }
 
-    sendCommand(cmd, payload);
+    sendCommandImmediately(cmd, payload);
 }
 
 void QAtemConnection::aquireLock(quint8 storeId)
@@ -1521,12 +2429,20 @@ void QAtemConnection::aquireLock(quint8 storeId)
     payload[1] = static_cast<char>(storeId);
     payload[2] = 0x01;
 
-    sendCommand(cmd, payload);
+    sendCommandImmediately(cmd, payload);
+    m_lockRequestTimes.insert(storeId, m_lockTimer.elapsed());
 }
 
 void QAtemConnection::onLKOB(const QByteArray& payload)
 {
-    emit getLockStateChanged(static_cast<quint8>(payload.at(7)), true);
+    quint8 storeId = static_cast<quint8>(payload.at(7));
+    recordLockWait(storeId);
+    emit getLockStateChanged(storeId, true);
+
+    if(m_transferInterrupted && m_transferLockRequested && m_transferDownload && storeId == m_transferStoreId)
+    {
+        restartTransfer();
+    }
 }
 
 void QAtemConnection::onFTDa(const QByteArray& payload)
@@ -1544,6 +2460,8 @@ void QAtemConnection::onFTDa(const QByteArray& payload)
     val.u8[1] = static_cast<quint8>(payload.at(8));
     val.u8[0] = static_cast<quint8>(payload.at(9));
     m_transferData.append(payload.mid(10, val.u16));
+    m_transferTelemetry.bytesAcked = m_transferData.size();
+    updateTransferTelemetry();
 
     QTimer::singleShot(50, this, SLOT(acceptData()));
 }
@@ -1559,69 +2477,214 @@ void QAtemConnection::acceptData()
     payload[1] = static_cast<char>(val.u8[0]);
     payload[3] = static_cast<char>(m_transferIndex);
 
-    sendCommand(cmd, payload);
+    sendCommandImmediately(cmd, payload);
 }
 
 void QAtemConnection::onFTDE(const QByteArray& payload)
 {
     qWarning() << "Data transfer error:" << payload.toHex();
+
+    QAtem::U16_U8 id;
+    id.u8[1] = static_cast<quint8>(payload.at(6));
+    id.u8[0] = static_cast<quint8>(payload.at(7));
+
+    if(id.u16 == m_transferId && m_transferActive)
+    {
+        failTransfer();
+    }
 }
 
-QByteArray QAtemConnection::prepImageForSwitcher(QImage &image, const int width, const int height)
+QByteArray QAtemConnection::prepImageForSwitcher(const QImage &image, const int width, const int height, QAtem::ImageScaleMode mode,
+                                                  QAtem::ColorMatrix matrix)
 {
-    // Size the image
-    image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    // Convert pixels in pairs for 4:2:2 compression
+    QByteArray data(width*height*4, Qt::Uninitialized);
 
-    if(image.width() > width) {
-        image = image.copy((image.width()-width) / 2, 0, width, image.height());
+    // The pairs don't cover the last pixel of an odd pixel count, clear it instead of leaving it uninitialized
+    if((width * height) % 2)
+    {
+        memset(data.data() + data.size() - 4, 0, 4);
     }
-    if(image.height() > height) {
-        image = image.copy(0, (image.height()-height) / 2, image.width(), height);
+
+    QAtemImageConverter::convertImage(image, reinterpret_cast<uchar*>(data.data()), width, height, mode, matrix);
+
+    return data;
+}
+
+QFuture<QByteArray> QAtemConnection::prepImageForSwitcherAsync(const QImage &image, const int width, const int height, QAtem::ImageScaleMode mode,
+                                                               QAtem::ColorMatrix matrix)
+{
+    return QtConcurrent::run([=]() {
+        return prepImageForSwitcher(image, width, height, mode, matrix);
+    });
+}
+
+QByteArray QAtemConnection::prepImageForCurrentVideoMode(const QImage &image, QAtem::ImageScaleMode mode) const
+{
+    QSize size = currentVideoMode().size;
+
+    return prepImageForSwitcher(image, size.width(), size.height(), mode, colorMatrix());
+}
+
+QImage QAtemConnection::imageFromSwitcher(const QByteArray &data, const int width, const int height, QAtem::ColorMatrix matrix)
+{
+    if(width <= 0 || height <= 0)
+    {
+        return QImage();
     }
-    if(image.width() < width || image.height() < height) {
-        QImage blank(width, height, QImage::Format_ARGB32_Premultiplied);
-        blank.fill(QColor(0,0,0,0));
-        QPainter p(&blank);
-        p.drawImage(QPoint((width-image.width()) / 2, (height-image.height()) / 2), image);
-        image = blank;
+
+    QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+
+    if(!imageFromSwitcher(data, width, height, image.bits(), image.bytesPerLine(), matrix))
+    {
+        return QImage();
     }
 
-    // Convert pixels in pairs for 4:2:2 compression
-    QByteArray data(width*height*4, 0x00);
+    return image;
+}
+
+bool QAtemConnection::imageFromSwitcher(const QByteArray &data, const int width, const int height, uchar *buffer, int bytesPerLine,
+                                        QAtem::ColorMatrix matrix)
+{
+    const int frameSize = width * height * 4;
+    QByteArray frame = data;
+
+    // Run length encoding always changes the size, so a frame of the right size is never encoded
+    if(frame.size() != frameSize)
+    {
+        frame = decompressRLE(frame);
+    }
 
-    const QRgb *pixel = reinterpret_cast<const QRgb*>(image.constBits());
-    for(int i = 0; i < width * height; i+=2) {
+    if(width <= 0 || height <= 0 || frame.size() != frameSize)
+    {
+        return false;
+    }
 
-        unsigned char r1 = static_cast<quint8>(qRed(pixel[i+0]));
-        unsigned char g1 = static_cast<quint8>(qGreen(pixel[i+0]));
-        unsigned char b1 = static_cast<quint8>(qBlue(pixel[i+0]));
+    QAtemImageConverter::convertFrame(reinterpret_cast<const uchar*>(frame.constData()), width, height, buffer, bytesPerLine, matrix);
 
-        unsigned char r2 = static_cast<quint8>(qRed(pixel[i+1]));
-        unsigned char g2 = static_cast<quint8>(qGreen(pixel[i+1]));
-        unsigned char b2 = static_cast<quint8>(qBlue(pixel[i+1]));
+    return true;
+}
 
-        quint16 a1 = static_cast<quint16>(qAlpha(pixel[i+0]) * 3.7);
-        quint16 a2 = static_cast<quint16>(qAlpha(pixel[i+1]) * 3.7);
+QAtem::ColorMatrix QAtemConnection::colorMatrixForVideoFormat(quint8 format)
+{
+    // 0 - 3 are the NTSC and PAL modes
+    return (format <= 3) ? QAtem::Bt601Matrix : QAtem::Bt709Matrix;
+}
 
-        quint16 y1 = static_cast<quint16>((((66  * r1 + 129 * g1 +  25 * b1 + 128) >> 8) + 16 ) * 4 - 1);
-        quint16 u1 = static_cast<quint16>((((-38 * r1 -  74 * g1 + 112 * b1 + 128) >> 8) + 128) * 4 - 1);
-        quint16 y2 = static_cast<quint16>((((66  * r2 + 129 * g2 +  25 * b2 + 128) >> 8) + 16 ) * 4 - 1);
-        quint16 v2 = static_cast<quint16>((((112 * r2 -  94 * g2 -  18 * b2 + 128) >> 8) + 128) * 4 - 1);
+QByteArray QAtemConnection::compressRLE(const QByteArray &data)
+{
+    const int blockCount = data.size() / 8;
+    const char *src = data.constData();
+    QByteArray compressed;
+    compressed.reserve(data.size());
 
-        int j = i * 4;
+    int i = 0;
 
-        data[j+0] = static_cast<char>(a1 >> 4);
-        data[j+1] = static_cast<char>(((a1 & 0x0f) << 4) | (u1 >> 6));
-        data[j+2] = static_cast<char>(((u1 & 0x3f) << 2) | (y1 >> 8));
-        data[j+3] = static_cast<char>(y1 & 0xff);
+    while(i < blockCount)
+    {
+        quint64 block;
+        memcpy(&block, src + (i * 8), 8);
 
-        data[j+4] = static_cast<char>(a2 >> 4);
-        data[j+5] = static_cast<char>(((a2 & 0x0f) << 4) | (v2 >> 6));
-        data[j+6] = static_cast<char>(((v2 & 0x3f) << 2) | (y2 >> 8));
-        data[j+7] = static_cast<char>(y2 & 0xff);
+        int run = 1;
+
+        while((i + run) < blockCount && memcmp(src + ((i + run) * 8), &block, 8) == 0)
+        {
+            ++run;
+        }
+
+        // A run costs three blocks, a block that looks like the marker always has to be sent as a run
+        if(run > 3 || block == RLE_MARKER)
+        {
+            uchar header[16];
+            qToBigEndian<quint64>(RLE_MARKER, header);
+            qToBigEndian<quint64>(static_cast<quint64>(run), header + 8);
+            compressed.append(reinterpret_cast<const char*>(header), 16);
+            compressed.append(src + (i * 8), 8);
+        }
+        else
+        {
+            compressed.append(src + (i * 8), run * 8);
+        }
+
+        i += run;
     }
 
-    return data;
+    compressed.append(src + (blockCount * 8), data.size() - (blockCount * 8));
+
+    return compressed;
+}
+
+QByteArray QAtemConnection::decompressRLE(const QByteArray &data)
+{
+    const uchar *src = reinterpret_cast<const uchar*>(data.constData());
+    const int size = data.size();
+    qint64 decompressedSize = 0;
+    bool hasRuns = false;
+
+    // First pass finds the size of the decoded data so it can be written without reallocations
+    for(int i = 0; i < size;)
+    {
+        if((i + 24) <= size && qFromBigEndian<quint64>(src + i) == RLE_MARKER)
+        {
+            quint64 count = qFromBigEndian<quint64>(src + i + 8);
+
+            // Check before multiplying, a corrupt count would otherwise wrap around
+            if(count > static_cast<quint64>(0x7fffffff - decompressedSize) / 8)
+            {
+                qWarning() << "Run length encoded data is too large to decode";
+                return QByteArray();
+            }
+
+            decompressedSize += static_cast<qint64>(count) * 8;
+            hasRuns = true;
+            i += 24;
+        }
+        else
+        {
+            decompressedSize += qMin(8, size - i);
+            i += 8;
+        }
+    }
+
+    if(!hasRuns)
+    {
+        return data;
+    }
+
+    if(decompressedSize > 0x7fffffff)
+    {
+        qWarning() << "Run length encoded data is too large to decode:" << decompressedSize;
+        return QByteArray();
+    }
+
+    QByteArray decompressed(static_cast<int>(decompressedSize), Qt::Uninitialized);
+    char *dst = decompressed.data();
+    char *end = dst + decompressed.size();
+
+    for(int i = 0; i < size;)
+    {
+        if((i + 24) <= size && qFromBigEndian<quint64>(src + i) == RLE_MARKER)
+        {
+            quint64 count = qFromBigEndian<quint64>(src + i + 8);
+
+            for(quint64 j = 0; j < count && (end - dst) >= 8; ++j)
+            {
+                memcpy(dst, src + i + 16, 8);
+                dst += 8;
+            }
+
+            i += 24;
+        }
+        else
+        {
+            int length = qMin(qMin(8, size - i), static_cast<int>(end - dst));
+            memcpy(dst, src + i, static_cast<size_t>(length));
+            dst += length;
+            i += 8;
+        }
+    }
+
+    return decompressed;
 }
 
 void QAtemConnection::on_top(const QByteArray& payload)
@@ -1660,9 +2723,9 @@ QAtemDownstreamKey *QAtemConnection::downstreamKey(quint8 id) const
         return nullptr;
 }
 
-void QAtemConnection::registerCommand(const QByteArray &command, QObject *object, const QByteArray &slot)
+void QAtemConnection::registerCommand(const QByteArray &command, QObject *object, const QByteArray &slot, int index)
 {
-    m_commandSlotHash.insert(command, ObjectSlot(object, slot));
+    m_commandSlotHash.insert(command, ObjectSlot(object, slot, index));
 }
 
 void QAtemConnection::unregisterCommand(const QByteArray &command, QObject *object)
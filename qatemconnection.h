@@ -19,17 +19,25 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #define QATEMCONNECTION_H
 
 #include "qatemtypes.h"
+#include "qatemtransaction.h"
 #include "libqatemcontrol_global.h"
 
 #include <QObject>
 #include <QUdpSocket>
 #include <QColor>
+#include <QFuture>
+#include <QPointer>
+#include <QIODevice>
+#include <QQueue>
+#include <QElapsedTimer>
+#include <QVariant>
 
 class QTimer;
 class QHostAddress;
 class QAtemMixEffect;
 class QAtemCameraControl;
 class QAtemDownstreamKey;
+class QAtemAudioLevelSubscription;
 
 class LIBQATEMCONTROLSHARED_EXPORT QAtemConnection : public QObject
 {
@@ -37,6 +45,8 @@ class LIBQATEMCONTROLSHARED_EXPORT QAtemConnection : public QObject
 friend class QAtemMixEffect;
 friend class QAtemCameraControl;
 friend class QAtemDownstreamKey;
+friend class QAtemAudioLevelSubscription;
+friend class QAtemTransaction;
 public:
     enum Command
     {
@@ -73,6 +83,7 @@ public:
 
     /// Connect to ATEM switcher at @p address
     void connectToSwitcher(const QHostAddress& address, int connectionTimeout = 1000);
+    /// Disconnect from the switcher, a transfer in progress fails as it is only restarted after a lost connection
     void disconnectFromSwitcher();
 
     void setDebugEnabled(bool enabled) { m_debugEnabled = enabled; }
@@ -117,6 +128,12 @@ public:
     QMap<quint8, QAtem::VideoMode> availableVideoModes() const { return m_availableVideoModes; }
     /// @returns index of the video format in use. 0 = 525i5994, 1 = 625i50, 2 = 525i5994 16:9, 3 = 625i50 16:9, 4 = 720p50, 5 = 720p5994, 6 = 1080i50, 7 = 1080i5994
     quint8 videoFormat() const { return m_videoFormat; }
+    /// @returns the video mode in use
+    QAtem::VideoMode currentVideoMode() const { return m_availableVideoModes.value(m_videoFormat); }
+    /// @returns the colour matrix frames are converted with in the video mode in use
+    QAtem::ColorMatrix colorMatrix() const { return colorMatrixForVideoFormat(m_videoFormat); }
+    /// @returns BT.601 for the standard definition video formats and BT.709 for the rest
+    static QAtem::ColorMatrix colorMatrixForVideoFormat(quint8 format);
     /// @returns type of video down coversion, 0 = Center cut, 1 = Letterbox, 2 = Anamorphic
     quint8 videoDownConvertType() const { return m_videoDownConvertType; }
 
@@ -146,7 +163,9 @@ public:
     float audioMonitorLevel() const { return m_audioMonitorLevel; }
     float audioMasterOutputGain() const { return m_audioMasterOutputGain; }
 
-    QAtem::AudioLevel audioLevel(quint16 index) const { return m_audioLevels.value(index); }
+    QAtem::AudioLevel audioLevel(quint16 index) const;
+    /// @returns the levels of all audio inputs in the order the switcher sends them
+    const QVector<QAtem::AudioLevel> &audioLevels() const { return m_audioLevels; }
     float audioMasterOutputLevelLeft() const { return m_audioMasterOutputLevelLeft;}
     float audioMasterOutputLevelRight() const { return m_audioMasterOutputLevelRight;}
     float audioMasterOutputPeakLeft() const { return m_audioMasterOutputPeakLeft; }
@@ -156,7 +175,7 @@ public:
     bool hasAudioMonitor() const { return m_hasAudioMonitor; }
 
     /// Aquire the media pool lock with ID @p id. @returns false if the lock is already locked.
-    bool aquireMediaLock(quint8 id, quint8 index);
+    bool aquireMediaLock(quint8 id, quint16 index);
     /// Unlock the media pool lock with ID @p id.
     void unlockMediaLock(quint8 id);
     /// @returns the state of the media pool lock with ID @p id.
@@ -164,19 +183,57 @@ public:
 
     void aquireLock(quint8 storeId);
 
+    /// @returns the store and media pool lock ID of media pool clip @p clip, which holds both its frames and its audio
+    static quint8 clipStoreId(quint8 clip) { return static_cast<quint8>(clip + 1); }
+
     /**
      * @brief Send data to a store in the switcher.
-     * @param storeId 0 = Still store, 1 = Clip store, 2 = Sound store, 3 = Multiview labels, 255 = Macros
-     * @param index Index in the store
+     * @param storeId 0 = Still store, clipStoreId() = Store of a media pool clip, 255 = Macros
+     * @param index Index in the store, for clips the frame index in the clip
      * @param name Name shown to the user
-     * @param data Actual pixel or sound data
+     * @param data Actual pixel data
+     * @return Returns the ID of the data transfer if success else 0
+     */
+    quint16 sendDataToSwitcher(quint8 storeId, quint16 index, const QByteArray &name, const QByteArray &data);
+    /**
+     * @brief Send @p size bytes read from @p device to a store in the switcher.
+     * The data is read from @p device as the switcher asks for it, so @p device has to stay open until
+     * dataTransferFinished() is emitted. The data is never run length encoded.
+     * @param hash MD5 of the data
      * @return Returns the ID of the data transfer if success else 0
      */
-    quint16 sendDataToSwitcher(quint8 storeId, quint8 index, const QByteArray &name, const QByteArray &data);
+    quint16 sendDataToSwitcher(quint8 storeId, quint16 index, const QByteArray &name, QIODevice *device, qint64 size, const QByteArray &hash);
+    /**
+     * @brief Send @p size bytes of audio read from @p device as the audio of media pool clip @p clip.
+     * The audio is kept in the store of the clip, the transfer mode tells it apart from the frames. @p device is
+     * read like in sendDataToSwitcher().
+     * @param hash MD5 of the audio
+     * @return Returns the ID of the data transfer if success else 0
+     */
+    quint16 sendClipAudioToSwitcher(quint8 clip, const QByteArray &name, QIODevice *device, qint64 size, const QByteArray &hash);
+    /// @returns true from the start of a transfer until it is finished, failed or canceled, also while it is interrupted
     bool transferActive() const { return m_transferActive; }
+    /// @returns true if the connection was lost during the current transfer and it hasn't been restarted yet
+    bool transferInterrupted() const { return m_transferInterrupted; }
+    /**
+     * Abandon the current transfer. The transfer is otherwise kept when the connection is lost and is restarted
+     * from the retained buffer, or from the start of the device, when the connection is back up.
+     */
+    void cancelTransfer();
+    /// Set to true to run length encode still and clip frames sent with sendDataToSwitcher(). Enabled by default.
+    void setTransferCompressionEnabled(bool enabled) { m_transferCompressionEnabled = enabled; }
+    bool transferCompressionEnabled() const { return m_transferCompressionEnabled; }
     quint16 transferId () const { return m_transferId; }
-    int remainingTransferDataSize() const { return m_transferData.size(); }
-    quint16 getDataFromSwitcher(quint8 storeId, quint8 index);
+    /// @returns the number of bytes of the current upload that hasn't been sent yet
+    qint64 remainingTransferDataSize() const { return m_transferSize - m_transferSent; }
+    /// @returns the size of the current upload as sent to the switcher
+    qint64 transferSize() const { return m_transferSize; }
+    /// @returns the number of bytes of the current upload the switcher has acknowledged, counted from the start of the data
+    qint64 transferAckedSize() const { return m_transferAcked; }
+    /// @returns progress, throughput and flow control statistics for the current or last transfer
+    QAtem::TransferTelemetry transferTelemetry() const { return m_transferTelemetry; }
+    /// Request data from a store in the switcher. Still and clip frames are run length decoded when the transfer is finished.
+    quint16 getDataFromSwitcher(quint8 storeId, quint16 index);
     QByteArray transferData() const { return m_transferData; }
 
     /**
@@ -184,16 +241,87 @@ public:
      * @param image The image to convert
      * @param width Width of the frame the image will be converted to
      * @param height Height of the frame the image will be converted to
+     * @param mode How the image is scaled to the frame, by default it's centered and cropped or padded
+     * @param matrix Colour matrix used for the conversion
+     */
+    static QByteArray prepImageForSwitcher(const QImage &image, const int width, const int height, QAtem::ImageScaleMode mode = QAtem::CropImage,
+                                           QAtem::ColorMatrix matrix = QAtem::Bt601Matrix);
+    /**
+     * Convert @p image like prepImageForSwitcher() on the global QThreadPool.
+     * @returns a future that holds the converted frame when it's done
+     */
+    static QFuture<QByteArray> prepImageForSwitcherAsync(const QImage &image, const int width, const int height, QAtem::ImageScaleMode mode = QAtem::CropImage,
+                                                         QAtem::ColorMatrix matrix = QAtem::Bt601Matrix);
+    /// Convert @p image to a frame with the size and colour matrix of the video mode in use.
+    QByteArray prepImageForCurrentVideoMode(const QImage &image, QAtem::ImageScaleMode mode = QAtem::CropImage) const;
+
+    /**
+     * Convert frame @p data downloaded from the switcher to an image, the inverse of prepImageForSwitcher().
+     * Run length encoded data is decoded first.
+     * @returns a premultiplied ARGB32 image or a null image if @p data doesn't hold a @p width x @p height frame
+     */
+    static QImage imageFromSwitcher(const QByteArray &data, const int width, const int height, QAtem::ColorMatrix matrix = QAtem::Bt601Matrix);
+    /**
+     * Like imageFromSwitcher() but writes the premultiplied ARGB32 pixels to @p buffer, @p bytesPerLine bytes per row.
+     * @returns false if @p data doesn't hold a @p width x @p height frame
      */
-    static QByteArray prepImageForSwitcher(QImage &image, const int width, const int height);
+    static bool imageFromSwitcher(const QByteArray &data, const int width, const int height, uchar *buffer, int bytesPerLine,
+                                  QAtem::ColorMatrix matrix = QAtem::Bt601Matrix);
+
+    /**
+     * Run length encode frame @p data the way the switcher expects it for still transfers.
+     * Runs of identical 8 byte pixel pairs are replaced with a marker, a 64 bit repeat count and the pixel pair.
+     */
+    static QByteArray compressRLE(const QByteArray &data);
+    /// Decode run length encoded frame @p data, data without any runs is returned unchanged.
+    static QByteArray decompressRLE(const QByteArray &data);
 
     QAtem::Topology topology() const { return m_topology; }
 
     QAtemMixEffect *mixEffect(quint8 me) const;
 
-    void registerCommand(const QByteArray &command, QObject *object, const QByteArray &slot);
+    /**
+     * Call @p slot of @p object for every @p command received. If @p index isn't -1 the slot is only called for
+     * commands where the first byte of the payload, the ME or keyer index, is @p index.
+     */
+    void registerCommand(const QByteArray &command, QObject *object, const QByteArray &slot, int index = -1);
     void unregisterCommand(const QByteArray &command, QObject *object);
 
+    /**
+     * Limit the commands @p cmd sent by continuous setters, like gains, clips, positions and sizes, to @p rate per
+     * second for each parameter. Use 0 to only limit them by waiting for the switcher to acknowledge the last one.
+     */
+    void setCommandRate(const QByteArray &cmd, int rate) { m_commandRates.insert(cmd, rate); }
+    int commandRate(const QByteArray &cmd) const { return m_commandRates.value(cmd, m_defaultCommandRate); }
+    /// Set the rate used for commands without a rate set with setCommandRate(). Default is 30.
+    void setDefaultCommandRate(int rate) { m_defaultCommandRate = rate; }
+    int defaultCommandRate() const { return m_defaultCommandRate; }
+    /**
+     * Enable optimistic updates. Setters that support it then update the local state and emit the change signal
+     * right away, instead of waiting for the switcher to report the new state. The state reported by the switcher
+     * confirms or corrects the update, if the switcher doesn't report the new state within optimisticTimeout()
+     * the update is rolled back to the last state it reported. Disabled by default.
+     */
+    void setOptimisticUpdatesEnabled(bool enabled) { m_optimisticUpdatesEnabled = enabled; }
+    bool optimisticUpdatesEnabled() const { return m_optimisticUpdatesEnabled; }
+    /// Set the time in milliseconds to wait for the switcher to confirm an optimistic update. Default is 1000.
+    void setOptimisticTimeout(int msecs) { m_optimisticTimeout = msecs; }
+    int optimisticTimeout() const { return m_optimisticTimeout; }
+
+    /**
+     * Start a transaction, the commands of the setters called until it is committed or cancelled are queued in it
+     * and sent together. @returns the open transaction if there already is one. The transaction is owned by the
+     * connection and deletes itself when it has finished.
+     */
+    QAtemTransaction *beginTransaction();
+    /// @returns the open transaction or nullptr if there is none
+    QAtemTransaction *currentTransaction() const { return m_transaction; }
+    /// @returns true if a transaction is open, setters then skip commands that wouldn't change the current state
+    bool inTransaction() const { return !m_transaction.isNull(); }
+
+    /// @returns the smoothed round trip time to the switcher in milliseconds, -1 until the first command has been acknowledged
+    float roundTripTime() const { return m_roundTripTime; }
+
     /// @returns the power status as a bitmask. Bit 0: Main power on/off, 1: Backup power on/off
     quint8 powerStatus() const { return m_powerStatus; }
 
@@ -238,6 +366,8 @@ public slots:
 
     /// Sets the size of media pool clip 1 to @p size, max is mediaPoolClipBankCount(). Clip 2 size will be mediaPoolClipBankCount() - @p size.
     void setMediaPoolClipSplit(quint16 size);
+    /// Sets the name of media pool clip @p clip to @p name and its length to @p frameCount frames.
+    void setMediaPoolClip(quint8 clip, const QString &name, quint16 frameCount);
 
     /// Sets the layout of multi viewer @p multiView to @p layout.
     void setMultiViewLayout(quint8 multiView, quint8 layout);
@@ -326,18 +456,103 @@ protected slots:
     void onFTDE(const QByteArray& payload);
     void onLKOB(const QByteArray& payload);
 
+    /// Send the pending coalesced commands that are due
+    void sendCoalescedCommands();
+    /// Roll back the optimistic updates the switcher hasn't confirmed in time
+    void expirePendingUpdates();
+
     void initDownloadToSwitcher();
     void flushTransferBuffer(quint8 count);
     void acceptData();
 
 protected:
+    struct TransferChunk
+    {
+        quint16 packetId;
+        qint64 end;
+    };
+
+    /// Update the acknowledged size of the current upload from an ack of packet @p packetId
+    void handleTransferAck(quint16 packetId);
+    /// Keep the current transfer so it can be restarted when the connection is back up
+    void interruptTransfer();
+    /// Request the lock needed to restart an interrupted transfer
+    void resumeTransfer();
+    /// Restart an interrupted transfer from the beginning, the lock has to be held
+    void restartTransfer();
+    /// Start an upload of @p size bytes read from @p device, as clip audio if @p audio is true
+    quint16 startDeviceTransfer(quint8 storeId, quint16 index, const QByteArray &name, QIODevice *device, qint64 size,
+                                const QByteArray &hash, bool audio);
+    /// Reset the transfer state and emit dataTransferFailed()
+    void failTransfer();
+    void resetUpload();
+    /// Start collecting telemetry for the current transfer
+    void startTransferTelemetry();
+    /// Update the throughput and time estimates of the current transfer and emit dataTransferProgress()
+    void updateTransferTelemetry();
+    /// Record how long it took to get the lock with ID @p id if it was requested by this connection
+    void recordLockWait(quint8 id);
+
+    /// Append the next block of data from the transfer device to the transfer buffer
+    void readTransferDevice();
+
     QByteArray createCommandHeader(Commands bitmask, quint16 payloadSize, quint16 uid, quint16 ackId);
 
     QAtemConnection::CommandHeader parseCommandHeader(const QByteArray& datagram) const;
     void parsePayLoad(const QByteArray& datagram);
 
     bool sendDatagram(const QByteArray& datagram);
+    /// Send @p cmd with @p payload, or queue it in the open transaction replacing the one queued for the same parameter
     bool sendCommand(const QByteArray& cmd, const QByteArray &payload);
+    /// Send @p cmd with @p payload right away, even if a transaction is open
+    bool sendCommandImmediately(const QByteArray &cmd, const QByteArray &payload);
+    /**
+     * Send @p commands packed in as few datagrams as possible.
+     * @returns the IDs of the packets they were sent in
+     */
+    QVector<quint16> sendCommands(const QVector<QPair<QByteArray, QByteArray> > &commands);
+    /// Send the encoded @p commands in a datagram requesting an ack
+    bool sendPacket(const QByteArray &commands);
+    /// @returns @p cmd with @p payload encoded with its command header
+    static QByteArray encodeCommand(const QByteArray &cmd, const QByteArray &payload);
+    /// Fail the committed transactions still waiting for acks, the connection has been lost
+    void failTransactions();
+    /**
+     * Send @p cmd with the latest value wins semantics used for continuous parameters. The first @p keySize bytes of
+     * @p payload, the mask and the indexes, identify the parameter. While a command for the parameter waits for an
+     * ack from the switcher or for the rate limit only the newest payload is kept.
+     */
+    void sendCoalescedCommand(const QByteArray &cmd, const QByteArray &payload, int keySize);
+    /**
+     * Called by setters when the value is already current. Drops the command for the parameter @p payload of @p cmd
+     * sets from the open transaction, so an earlier value set in the same transaction isn't sent instead. If a
+     * coalesced value for the parameter is waiting for the rate limit or an ack, @p payload is sent after it.
+     */
+    void dropQueuedCommand(const QByteArray &cmd, const QByteArray &payload);
+    /**
+     * Drop the values of @p cmd waiting for an ack or the rate limit whose payload holds @p indexes at @p offset,
+     * for every mask. Used before sending a value that covers all of them.
+     */
+    void dropCoalescedCommands(const QByteArray &cmd, int offset, const QByteArray &indexes);
+    /**
+     * @returns the key identifying the parameter @p payload of @p cmd sets in a transaction, @p cmd followed by
+     * the mask and the indexes. Commands that aren't known to set a parameter, like cut, use the whole payload.
+     */
+    static QByteArray transactionKey(const QByteArray &cmd, const QByteArray &payload);
+    /// Update round trip times and coalesced commands from an ack of packet @p packetId
+    void handleCommandAck(quint16 packetId);
+
+    /**
+     * Register an optimistic update of the state identified by @p key to @p expected, @p current is the state
+     * before the update. If it isn't confirmed in time the slot rollbackUpdate(QByteArray,QVariant) of @p object
+     * is called with the last state reported by the switcher.
+     */
+    void addPendingUpdate(const QByteArray &key, QObject *object, const QVariant &expected, const QVariant &current);
+    /**
+     * Reconcile the state @p reported by the switcher for @p key with a pending optimistic update.
+     * @returns false if the reported state should be ignored as a newer update is still pending
+     */
+    bool reconcileUpdate(const QByteArray &key, const QVariant &reported);
 
     void initCommandSlotHash();
 
@@ -345,6 +560,7 @@ protected:
     void sendFileDescription();
     void requestData();
 
+    /// Converts @p level to dB using a table with an entry for every level
     static float convertToDecibel(quint16 level);
     static quint16 convertFromDecibel(float level);
 
@@ -353,20 +569,57 @@ protected:
 private:
     struct ObjectSlot
     {
-        ObjectSlot(QObject *o, const QByteArray &s) : object(o), slot(s) {}
+        ObjectSlot(QObject *o, const QByteArray &s, int i = -1) : object(o), slot(s), index(i) {}
 
         inline bool operator ==(const ObjectSlot &b) const
         {
-            return (b.object == object && b.slot == slot);
+            return (b.object == object && b.slot == slot && b.index == index);
         }
 
         QObject *object;
         QByteArray slot;
+        int index;
     };
 
     QUdpSocket* m_socket;
     QTimer* m_connectionTimer;
 
+    struct CoalescedCommand
+    {
+        CoalescedCommand() : pending(false), inFlight(false), packetId(0), sentTime(0) {}
+
+        QByteArray cmd;
+        QByteArray payload;
+        bool pending;
+        bool inFlight;
+        quint16 packetId;
+        qint64 sentTime;
+    };
+
+    QHash<QByteArray, CoalescedCommand> m_coalescedCommands;
+    QHash<QByteArray, int> m_commandRates;
+    int m_defaultCommandRate;
+    QTimer *m_coalesceTimer;
+    QElapsedTimer m_commandClock;
+    QQueue<QPair<quint16, qint64> > m_sentPackets;
+    float m_roundTripTime;
+
+    struct PendingUpdate
+    {
+        QPointer<QObject> object;
+        QVariant expected;
+        QVariant confirmed;
+        qint64 deadline;
+    };
+
+    bool m_optimisticUpdatesEnabled;
+    int m_optimisticTimeout;
+    QHash<QByteArray, PendingUpdate> m_pendingUpdates;
+    QTimer *m_pendingUpdateTimer;
+
+    QPointer<QAtemTransaction> m_transaction;
+    QList<QPointer<QAtemTransaction> > m_committedTransactions;
+
     QHostAddress m_address;
     quint16 m_port;
 
@@ -417,7 +670,10 @@ private:
 
     QHash<quint16, QAtem::AudioInput> m_audioInputs;
     QHash<quint16, bool> m_audioTally;
-    QHash<quint16, QAtem::AudioLevel> m_audioLevels;
+    QVector<QAtem::AudioLevel> m_audioLevels;
+    QVector<quint16> m_audioLevelIds;
+    QHash<quint16, int> m_audioLevelSlots;
+    QList<QAtemAudioLevelSubscription*> m_audioLevelSubscriptions;
 
     bool m_audioMonitorEnabled;
     float m_audioMonitorGain;
@@ -438,9 +694,30 @@ private:
     QHash<quint8, bool> m_mediaLocks;
 
     bool m_transferActive;
+    bool m_transferDownload;
+    bool m_transferCompressed;
+    bool m_transferAudio;
+    bool m_transferCompressionEnabled;
+    bool m_transferInterrupted;
+    bool m_transferLockRequested;
+    bool m_transferDescriptionSent;
     QByteArray m_transferData;
+    int m_transferOffset;
+    qint64 m_transferSize;
+    qint64 m_transferSent;
+    qint64 m_transferAcked;
+    QQueue<TransferChunk> m_transferChunks;
+    QAtem::TransferTelemetry m_transferTelemetry;
+    QElapsedTimer m_transferTimer;
+    qint64 m_throughputWindowStart;
+    qint64 m_throughputWindowBytes;
+    QElapsedTimer m_lockTimer;
+    QHash<quint8, qint64> m_lockRequestTimes;
+    QHash<quint8, qint64> m_lockWaitTimes;
+    QPointer<QIODevice> m_transferDevice;
+    qint64 m_transferDeviceRemaining;
     quint8 m_transferStoreId;
-    quint8 m_transferIndex;
+    quint16 m_transferIndex;
     QByteArray m_transferName;
     quint16 m_transferId;
     quint16 m_lastTransferId;
@@ -505,6 +782,17 @@ signals:
     void getLockStateChanged(quint8 storeId, bool state);
 
     void dataTransferFinished(quint16 transferId);
+    /// Emitted when the connection is lost during transfer @p transferId, it's restarted when the connection is back up
+    void dataTransferInterrupted(quint16 transferId);
+    /**
+     * Emitted when more data of transfer @p transferId has been acknowledged by the switcher, or received from it.
+     * @p bytesTotal is 0 for downloads. See transferTelemetry() for throughput and time estimates.
+     */
+    void dataTransferProgress(quint16 transferId, qint64 bytesDone, qint64 bytesTotal);
+    /// Emitted when the interrupted transfer @p transferId has been restarted after reconnecting
+    void dataTransferResumed(quint16 transferId);
+    /// Emitted when the switcher reports an error for transfer @p transferId or it can't be restarted
+    void dataTransferFailed(quint16 transferId);
 
     void topologyChanged(const QAtem::Topology &topology);
 
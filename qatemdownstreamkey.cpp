@@ -37,9 +37,9 @@ QAtemDownstreamKey::QAtemDownstreamKey(quint8 id, QAtemConnection *parent) :
     m_leftMask = 0;
     m_rightMask = 0;
 
-    m_atemConnection->registerCommand("DskS", this, "onDskS");
-    m_atemConnection->registerCommand("DskP", this, "onDskP");
-    m_atemConnection->registerCommand("DskB", this, "onDskB");
+    m_atemConnection->registerCommand("DskS", this, "onDskS", m_id);
+    m_atemConnection->registerCommand("DskP", this, "onDskP", m_id);
+    m_atemConnection->registerCommand("DskB", this, "onDskB", m_id);
 }
 
 QAtemDownstreamKey::~QAtemDownstreamKey()
@@ -51,34 +51,50 @@ QAtemDownstreamKey::~QAtemDownstreamKey()
 
 void QAtemDownstreamKey::setOnAir(bool state)
 {
-    if(state == m_onAir)
-    {
-        return;
-    }
-
     QByteArray cmd("CDsL");
     QByteArray payload(4, 0x0);
 
     payload[0] = static_cast<char>(m_id);
     payload[1] = static_cast<char>(state);
 
+    if(state == m_onAir)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
-}
 
-void QAtemDownstreamKey::setTie(bool state)
-{
-    if(state == m_tie)
+    if(m_atemConnection->optimisticUpdatesEnabled())
     {
-        return;
+        m_atemConnection->addPendingUpdate(updateKey("DskS"), this, state, m_onAir);
+        m_onAir = state;
+        emit onAirChanged(m_id, m_onAir);
     }
+}
 
+void QAtemDownstreamKey::setTie(bool state)
+{
     QByteArray cmd("CDsT");
     QByteArray payload(4, 0x0);
 
     payload[0] = static_cast<char>(m_id);
     payload[1] = static_cast<char>(state);
 
+    if(state == m_tie)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
+
+    if(m_atemConnection->optimisticUpdatesEnabled())
+    {
+        m_atemConnection->addPendingUpdate(updateKey("DskP"), this, state, m_tie);
+        m_tie = state;
+        emit tieChanged(m_id, m_tie);
+    }
 }
 
 void QAtemDownstreamKey::doAuto()
@@ -93,11 +109,6 @@ void QAtemDownstreamKey::doAuto()
 
 void QAtemDownstreamKey::setFillSource(quint16 source)
 {
-    if(source == m_fillSource)
-    {
-        return;
-    }
-
     QByteArray cmd("CDsF");
     QByteArray payload(4, 0x0);
     QAtem::U16_U8 val;
@@ -107,16 +118,17 @@ void QAtemDownstreamKey::setFillSource(quint16 source)
     payload[2] = static_cast<char>(val.u8[1]);
     payload[3] = static_cast<char>(val.u8[0]);
 
+    if(source == m_fillSource)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
 void QAtemDownstreamKey::setKeySource(quint16 source)
 {
-    if(source == m_keySource)
-    {
-        return;
-    }
-
     QByteArray cmd("CDsC");
     QByteArray payload(4, 0x0);
     QAtem::U16_U8 val;
@@ -126,32 +138,34 @@ void QAtemDownstreamKey::setKeySource(quint16 source)
     payload[2] = static_cast<char>(val.u8[1]);
     payload[3] = static_cast<char>(val.u8[0]);
 
+    if(source == m_keySource)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
 void QAtemDownstreamKey::setFrameRate(quint8 frames)
 {
-    if(frames == m_frameRate)
-    {
-        return;
-    }
-
     QByteArray cmd("CDsR");
     QByteArray payload(4, 0x0);
 
     payload[0] = static_cast<char>(m_id);
     payload[1] = static_cast<char>(frames);
 
+    if(frames == m_frameRate)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
 void QAtemDownstreamKey::setInvertKey(bool invert)
 {
-    if(invert == m_invertKey)
-    {
-        return;
-    }
-
     QByteArray cmd("CDsG");
     QByteArray payload(12, 0x0);
 
@@ -159,16 +173,17 @@ void QAtemDownstreamKey::setInvertKey(bool invert)
     payload[1] = static_cast<char>(m_id);
     payload[8] = static_cast<char>(invert);
 
+    if(invert == m_invertKey)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
 void QAtemDownstreamKey::setPreMultiplied(bool preMultiplied)
 {
-    if(preMultiplied == m_preMultiplied)
-    {
-        return;
-    }
-
     QByteArray cmd("CDsG");
     QByteArray payload(12, 0x0);
 
@@ -176,16 +191,17 @@ void QAtemDownstreamKey::setPreMultiplied(bool preMultiplied)
     payload[1] = static_cast<char>(m_id);
     payload[2] = preMultiplied;
 
+    if(preMultiplied == m_preMultiplied)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
 void QAtemDownstreamKey::setClip(float clip)
 {
-    if(qFuzzyCompare(clip, m_clip))
-    {
-        return;
-    }
-
     QByteArray cmd("CDsG");
     QByteArray payload(12, 0x0);
     QAtem::U16_U8 val;
@@ -196,16 +212,17 @@ void QAtemDownstreamKey::setClip(float clip)
     payload[4] = static_cast<char>(val.u8[1]);
     payload[5] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
-}
-
-void QAtemDownstreamKey::setGain(float gain)
-{
-    if(qFuzzyCompare(gain, m_gain))
+    if(qFuzzyCompare(clip, m_clip))
     {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
         return;
     }
 
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 2);
+}
+
+void QAtemDownstreamKey::setGain(float gain)
+{
     QByteArray cmd("CDsG");
     QByteArray payload(12, 0x0);
     QAtem::U16_U8 val;
@@ -216,16 +233,17 @@ void QAtemDownstreamKey::setGain(float gain)
     payload[6] = static_cast<char>(val.u8[1]);
     payload[7] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
-}
-
-void QAtemDownstreamKey::setEnableMask(bool enable)
-{
-    if(enable == m_enableMask)
+    if(qFuzzyCompare(gain, m_gain))
     {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
         return;
     }
 
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 2);
+}
+
+void QAtemDownstreamKey::setEnableMask(bool enable)
+{
     QByteArray cmd("CDsM");
     QByteArray payload(12, 0x0);
 
@@ -233,6 +251,12 @@ void QAtemDownstreamKey::setEnableMask(bool enable)
     payload[1] = static_cast<char>(m_id);
     payload[2] = enable;
 
+    if(enable == m_enableMask)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
@@ -257,7 +281,28 @@ void QAtemDownstreamKey::setMask(float top, float bottom, float left, float righ
     payload[10] = static_cast<char>(val.u8[1]);
     payload[11] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 2);
+}
+
+QByteArray QAtemDownstreamKey::updateKey(const char *command) const
+{
+    return QByteArray(command).append(static_cast<char>(m_id));
+}
+
+void QAtemDownstreamKey::rollbackUpdate(const QByteArray &key, const QVariant &value)
+{
+    QByteArray command = key.left(4);
+
+    if(command == "DskS")
+    {
+        m_onAir = value.toBool();
+        emit onAirChanged(m_id, m_onAir);
+    }
+    else if(command == "DskP")
+    {
+        m_tie = value.toBool();
+        emit tieChanged(m_id, m_tie);
+    }
 }
 
 void QAtemDownstreamKey::onDskS(const QByteArray& payload)
@@ -271,7 +316,13 @@ void QAtemDownstreamKey::onDskS(const QByteArray& payload)
         bool temp_inAutoTransition = m_inAutoTransition;
         quint8 temp_frameCount = m_frameCount;
 
-        m_onAir = payload.at(7);
+        bool onAir = payload.at(7);
+
+        if(m_atemConnection->reconcileUpdate(updateKey("DskS"), onAir))
+        {
+            m_onAir = onAir;
+        }
+
         m_inTransition = payload.at(8);
         m_inAutoTransition = payload.at(9);
         m_frameCount = static_cast<quint8>(payload.at(10));
@@ -301,7 +352,13 @@ void QAtemDownstreamKey::onDskP(const QByteArray& payload)
 
     if(index == m_id)
     {
-        m_tie = payload.at(7);
+        bool tie = payload.at(7);
+
+        if(m_atemConnection->reconcileUpdate(updateKey("DskP"), tie))
+        {
+            m_tie = tie;
+        }
+
         m_frameRate = static_cast<quint8>(payload.at(8));
         m_preMultiplied = payload.at(9);
         QAtem::U16_U8 val;
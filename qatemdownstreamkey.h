@@ -19,6 +19,7 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #define DOWNSTREAMKEY_H
 
 #include <QObject>
+#include <QVariant>
 #include "libqatemcontrol_global.h"
 
 class QAtemConnection;
@@ -80,6 +81,12 @@ protected slots:
     void onDskS(const QByteArray &payload);
     void onDskP(const QByteArray &payload);
     void onDskB(const QByteArray &payload);
+    /// Restore the state identified by @p key to @p value when an optimistic update wasn't confirmed in time
+    void rollbackUpdate(const QByteArray &key, const QVariant &value);
+
+protected:
+    /// @returns the key identifying the state set by @p command on this keyer for optimistic updates
+    QByteArray updateKey(const char *command) const;
 
 private:
     quint8 m_id;
@@ -0,0 +1,1041 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "qatemimageconverter.h"
+
+#include <QAtomicInt>
+#include <QImage>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrentMap>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define QATEM_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)) && Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+#define QATEM_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define QATEM_TARGET(x) __attribute__((target(x)))
+#else
+#define QATEM_TARGET(x)
+#endif
+
+/*
+ * All kernels produce the same output as the original per pixel pair conversion, with the coefficients of the
+ * selected colour matrix. For BT.601:
+ *
+ * Y = ((( 66 * R + 129 * G +  25 * B + 128) >> 8) +  16) * 4 - 1
+ * U = (((-38 * R -  74 * G + 112 * B + 128) >> 8) + 128) * 4 - 1, from the first pixel of the pair
+ * V = (((112 * R -  94 * G -  18 * B + 128) >> 8) + 128) * 4 - 1, from the second pixel of the pair
+ * A = A * 3.7, done as A * 37 / 10 which truncates the same way for all 8 bit values
+ *
+ * Each pixel is stored as a big endian 32 bit word: A << 20 | C << 10 | Y where C is U or V.
+ * The sums fit in 16 bits, unsigned for Y and signed for U and V, so the SIMD kernels work on 16 bit lanes
+ * and split the word in a high half, A << 4 | C >> 6, and a low half, C << 10 | Y.
+ */
+
+struct ColorCoefficients
+{
+    qint16 yR, yG, yB;
+    qint16 uR, uG, uB;
+    qint16 vR, vG, vB;
+};
+
+// Studio range coefficients scaled by 256, indexed by QAtem::ColorMatrix
+static const ColorCoefficients s_coefficients[2] =
+{
+    { 66, 129, 25, -38, -74, 112, 112, -94, -18 },
+    { 47, 157, 16, -26, -87, 113, 112, -102, -10 }
+};
+
+/// Per channel products for the scalar kernel, the rounding is folded into the red tables.
+struct ColorTables
+{
+    explicit ColorTables(const ColorCoefficients &c)
+    {
+        for(int i = 0; i < 256; ++i)
+        {
+            yR[i] = c.yR * i + 128;
+            yG[i] = c.yG * i;
+            yB[i] = c.yB * i;
+            uR[i] = c.uR * i + 128;
+            uG[i] = c.uG * i;
+            uB[i] = c.uB * i;
+            vR[i] = c.vR * i + 128;
+            vG[i] = c.vG * i;
+            vB[i] = c.vB * i;
+            alpha[i] = static_cast<quint16>((i * 37) / 10);
+        }
+    }
+
+    qint32 yR[256], yG[256], yB[256];
+    qint32 uR[256], uG[256], uB[256];
+    qint32 vR[256], vG[256], vB[256];
+    quint16 alpha[256];
+};
+
+static const ColorTables &colorTables(QAtem::ColorMatrix matrix)
+{
+    static const ColorTables bt601(s_coefficients[QAtem::Bt601Matrix]);
+    static const ColorTables bt709(s_coefficients[QAtem::Bt709Matrix]);
+
+    return (matrix == QAtem::Bt709Matrix) ? bt709 : bt601;
+}
+
+/// @returns @p even and @p odd packed in a 32 bit lane for the even and odd pixels of a pair
+static inline int packPair(qint16 even, qint16 odd)
+{
+    return static_cast<int>((static_cast<quint32>(static_cast<quint16>(odd)) << 16) | static_cast<quint16>(even));
+}
+
+static inline void convertPairScalar(QRgb p1, QRgb p2, const ColorTables &t, uchar *dst)
+{
+    int r1 = qRed(p1);
+    int g1 = qGreen(p1);
+    int b1 = qBlue(p1);
+
+    int r2 = qRed(p2);
+    int g2 = qGreen(p2);
+    int b2 = qBlue(p2);
+
+    quint16 a1 = t.alpha[qAlpha(p1)];
+    quint16 a2 = t.alpha[qAlpha(p2)];
+
+    quint16 y1 = static_cast<quint16>((((t.yR[r1] + t.yG[g1] + t.yB[b1]) >> 8) + 16 ) * 4 - 1);
+    quint16 u1 = static_cast<quint16>((((t.uR[r1] + t.uG[g1] + t.uB[b1]) >> 8) + 128) * 4 - 1);
+    quint16 y2 = static_cast<quint16>((((t.yR[r2] + t.yG[g2] + t.yB[b2]) >> 8) + 16 ) * 4 - 1);
+    quint16 v2 = static_cast<quint16>((((t.vR[r2] + t.vG[g2] + t.vB[b2]) >> 8) + 128) * 4 - 1);
+
+    dst[0] = static_cast<uchar>(a1 >> 4);
+    dst[1] = static_cast<uchar>(((a1 & 0x0f) << 4) | (u1 >> 6));
+    dst[2] = static_cast<uchar>(((u1 & 0x3f) << 2) | (y1 >> 8));
+    dst[3] = static_cast<uchar>(y1 & 0xff);
+
+    dst[4] = static_cast<uchar>(a2 >> 4);
+    dst[5] = static_cast<uchar>(((a2 & 0x0f) << 4) | (v2 >> 6));
+    dst[6] = static_cast<uchar>(((v2 & 0x3f) << 2) | (y2 >> 8));
+    dst[7] = static_cast<uchar>(y2 & 0xff);
+}
+
+static void convertArgbToYuvaScalar(const QRgb *src, uchar *dst, int count, QAtem::ColorMatrix matrix)
+{
+    const ColorTables &tables = colorTables(matrix);
+
+    for(int i = 0; i + 1 < count; i += 2)
+    {
+        convertPairScalar(src[i], src[i + 1], tables, dst + (i * 4));
+    }
+}
+
+#ifdef QATEM_X86
+QATEM_TARGET("sse2")
+static inline __m128i byteSwap16SSE2(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+QATEM_TARGET("sse2")
+static void convertArgbToYuvaSSE2(const QRgb *src, uchar *dst, int count, QAtem::ColorMatrix matrix)
+{
+    const ColorCoefficients &k = s_coefficients[matrix];
+    const __m128i byteMask = _mm_set1_epi32(0xff);
+    const __m128i yR = _mm_set1_epi16(k.yR);
+    const __m128i yG = _mm_set1_epi16(k.yG);
+    const __m128i yB = _mm_set1_epi16(k.yB);
+    // Even pixels carry U and odd pixels V
+    const __m128i cR = _mm_set1_epi32(packPair(k.uR, k.vR));
+    const __m128i cG = _mm_set1_epi32(packPair(k.uG, k.vG));
+    const __m128i cB = _mm_set1_epi32(packPair(k.uB, k.vB));
+    const __m128i round = _mm_set1_epi16(128);
+    const __m128i yOffset = _mm_set1_epi16(63);   // (x + 16) * 4 - 1
+    const __m128i cOffset = _mm_set1_epi16(511);  // (x + 128) * 4 - 1
+    const __m128i alphaScale = _mm_set1_epi16(37);
+    const __m128i divideBy10 = _mm_set1_epi16(6554); // (x * 6554) >> 16 == x / 10 for x <= 9435
+
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4));
+
+        __m128i b = _mm_packs_epi32(_mm_and_si128(p0, byteMask), _mm_and_si128(p1, byteMask));
+        __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), byteMask), _mm_and_si128(_mm_srli_epi32(p1, 8), byteMask));
+        __m128i r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), byteMask), _mm_and_si128(_mm_srli_epi32(p1, 16), byteMask));
+        __m128i a = _mm_packs_epi32(_mm_srli_epi32(p0, 24), _mm_srli_epi32(p1, 24));
+
+        __m128i y = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, yR), _mm_mullo_epi16(g, yG)),
+                                  _mm_add_epi16(_mm_mullo_epi16(b, yB), round));
+        y = _mm_add_epi16(_mm_slli_epi16(_mm_srli_epi16(y, 8), 2), yOffset);
+
+        __m128i c = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, cR), _mm_mullo_epi16(g, cG)),
+                                  _mm_add_epi16(_mm_mullo_epi16(b, cB), round));
+        c = _mm_add_epi16(_mm_slli_epi16(_mm_srai_epi16(c, 8), 2), cOffset);
+
+        a = _mm_mulhi_epu16(_mm_mullo_epi16(a, alphaScale), divideBy10);
+
+        __m128i hi = byteSwap16SSE2(_mm_or_si128(_mm_slli_epi16(a, 4), _mm_srli_epi16(c, 6)));
+        __m128i lo = byteSwap16SSE2(_mm_or_si128(_mm_slli_epi16(c, 10), y));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (i * 4)), _mm_unpacklo_epi16(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (i * 4) + 16), _mm_unpackhi_epi16(hi, lo));
+    }
+
+    convertArgbToYuvaScalar(src + i, dst + (i * 4), count - i, matrix);
+}
+
+QATEM_TARGET("avx2")
+static inline __m256i byteSwap16AVX2(__m256i v)
+{
+    return _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+}
+
+QATEM_TARGET("avx2")
+static void convertArgbToYuvaAVX2(const QRgb *src, uchar *dst, int count, QAtem::ColorMatrix matrix)
+{
+    const ColorCoefficients &k = s_coefficients[matrix];
+    const __m256i byteMask = _mm256_set1_epi32(0xff);
+    const __m256i yR = _mm256_set1_epi16(k.yR);
+    const __m256i yG = _mm256_set1_epi16(k.yG);
+    const __m256i yB = _mm256_set1_epi16(k.yB);
+    const __m256i cR = _mm256_set1_epi32(packPair(k.uR, k.vR));
+    const __m256i cG = _mm256_set1_epi32(packPair(k.uG, k.vG));
+    const __m256i cB = _mm256_set1_epi32(packPair(k.uB, k.vB));
+    const __m256i round = _mm256_set1_epi16(128);
+    const __m256i yOffset = _mm256_set1_epi16(63);
+    const __m256i cOffset = _mm256_set1_epi16(511);
+    const __m256i alphaScale = _mm256_set1_epi16(37);
+    const __m256i divideBy10 = _mm256_set1_epi16(6554);
+
+    int i = 0;
+
+    // The packs and unpacks work within 128 bit lanes, the two cancel out so the pixel order is kept
+    for(; i + 16 <= count; i += 16)
+    {
+        __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 8));
+
+        __m256i b = _mm256_packs_epi32(_mm256_and_si256(p0, byteMask), _mm256_and_si256(p1, byteMask));
+        __m256i g = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), byteMask), _mm256_and_si256(_mm256_srli_epi32(p1, 8), byteMask));
+        __m256i r = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), byteMask), _mm256_and_si256(_mm256_srli_epi32(p1, 16), byteMask));
+        __m256i a = _mm256_packs_epi32(_mm256_srli_epi32(p0, 24), _mm256_srli_epi32(p1, 24));
+
+        __m256i y = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(r, yR), _mm256_mullo_epi16(g, yG)),
+                                     _mm256_add_epi16(_mm256_mullo_epi16(b, yB), round));
+        y = _mm256_add_epi16(_mm256_slli_epi16(_mm256_srli_epi16(y, 8), 2), yOffset);
+
+        __m256i c = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(r, cR), _mm256_mullo_epi16(g, cG)),
+                                     _mm256_add_epi16(_mm256_mullo_epi16(b, cB), round));
+        c = _mm256_add_epi16(_mm256_slli_epi16(_mm256_srai_epi16(c, 8), 2), cOffset);
+
+        a = _mm256_mulhi_epu16(_mm256_mullo_epi16(a, alphaScale), divideBy10);
+
+        __m256i hi = byteSwap16AVX2(_mm256_or_si256(_mm256_slli_epi16(a, 4), _mm256_srli_epi16(c, 6)));
+        __m256i lo = byteSwap16AVX2(_mm256_or_si256(_mm256_slli_epi16(c, 10), y));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + (i * 4)), _mm256_unpacklo_epi16(hi, lo));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + (i * 4) + 32), _mm256_unpackhi_epi16(hi, lo));
+    }
+
+    convertArgbToYuvaSSE2(src + i, dst + (i * 4), count - i, matrix);
+}
+
+static bool cpuHasAVX2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+
+    if(info[0] < 7)
+    {
+        return false;
+    }
+
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+
+    if(!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) // The OS has to save the YMM registers
+    {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+static bool cpuHasSSE2()
+{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    return true;
+#elif defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#else
+    return false;
+#endif
+}
+#endif // QATEM_X86
+
+#ifdef QATEM_NEON
+static void convertArgbToYuvaNeon(const QRgb *src, uchar *dst, int count, QAtem::ColorMatrix matrix)
+{
+    const ColorCoefficients &k = s_coefficients[matrix];
+    const qint16 cRValues[8] = { k.uR, k.vR, k.uR, k.vR, k.uR, k.vR, k.uR, k.vR };
+    const qint16 cGValues[8] = { k.uG, k.vG, k.uG, k.vG, k.uG, k.vG, k.uG, k.vG };
+    const qint16 cBValues[8] = { k.uB, k.vB, k.uB, k.vB, k.uB, k.vB, k.uB, k.vB };
+    const int16x8_t cR = vld1q_s16(cRValues);
+    const int16x8_t cG = vld1q_s16(cGValues);
+    const int16x8_t cB = vld1q_s16(cBValues);
+
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        // QRgb is stored as B, G, R, A in memory on little endian CPUs
+        uint8x8x4_t p = vld4_u8(reinterpret_cast<const uint8_t*>(src + i));
+        uint16x8_t b = vmovl_u8(p.val[0]);
+        uint16x8_t g = vmovl_u8(p.val[1]);
+        uint16x8_t r = vmovl_u8(p.val[2]);
+        uint16x8_t a = vmovl_u8(p.val[3]);
+
+        uint16x8_t y = vmlaq_n_u16(vmlaq_n_u16(vmlaq_n_u16(vdupq_n_u16(128), r, k.yR), g, k.yG), b, k.yB);
+        y = vaddq_u16(vshlq_n_u16(vshrq_n_u16(y, 8), 2), vdupq_n_u16(63));
+
+        int16x8_t c = vmlaq_s16(vmlaq_s16(vmlaq_s16(vdupq_n_s16(128), vreinterpretq_s16_u16(r), cR),
+                                          vreinterpretq_s16_u16(g), cG),
+                                vreinterpretq_s16_u16(b), cB);
+        uint16x8_t cu = vreinterpretq_u16_s16(vaddq_s16(vshlq_n_s16(vshrq_n_s16(c, 8), 2), vdupq_n_s16(511)));
+
+        a = vmulq_n_u16(a, 37);
+        uint32x4_t aLow = vmull_n_u16(vget_low_u16(a), 6554);
+        uint32x4_t aHigh = vmull_n_u16(vget_high_u16(a), 6554);
+        a = vcombine_u16(vshrn_n_u32(aLow, 16), vshrn_n_u32(aHigh, 16));
+
+        uint16x8x2_t words;
+        words.val[0] = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(vorrq_u16(vshlq_n_u16(a, 4), vshrq_n_u16(cu, 6)))));
+        words.val[1] = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(vorrq_u16(vshlq_n_u16(cu, 10), y))));
+        vst2q_u16(reinterpret_cast<uint16_t*>(dst + (i * 4)), words);
+    }
+
+    convertArgbToYuvaScalar(src + i, dst + (i * 4), count - i, matrix);
+}
+#endif // QATEM_NEON
+
+typedef void (*ConvertFunction)(const QRgb *src, uchar *dst, int count, QAtem::ColorMatrix matrix);
+
+static QAtemImageConverter::Kernel detectKernel()
+{
+#ifdef QATEM_X86
+    if(cpuHasAVX2())
+    {
+        return QAtemImageConverter::AVX2Kernel;
+    }
+    else if(cpuHasSSE2())
+    {
+        return QAtemImageConverter::SSE2Kernel;
+    }
+#endif
+#ifdef QATEM_NEON
+    return QAtemImageConverter::NeonKernel;
+#else
+    return QAtemImageConverter::ScalarKernel;
+#endif
+}
+
+static QAtomicInt s_kernel(-1);
+
+QAtemImageConverter::Kernel QAtemImageConverter::kernel()
+{
+    int kernel = s_kernel.loadAcquire();
+
+    if(kernel < 0)
+    {
+        kernel = detectKernel();
+        s_kernel.testAndSetOrdered(-1, kernel);
+        kernel = s_kernel.loadAcquire();
+    }
+
+    return static_cast<Kernel>(kernel);
+}
+
+void QAtemImageConverter::setKernel(Kernel kernel)
+{
+    s_kernel.storeRelease(isKernelSupported(kernel) ? kernel : ScalarKernel);
+}
+
+bool QAtemImageConverter::isKernelSupported(Kernel kernel)
+{
+    switch(kernel)
+    {
+    case ScalarKernel:
+        return true;
+#ifdef QATEM_X86
+    case SSE2Kernel:
+        return cpuHasSSE2();
+    case AVX2Kernel:
+        return cpuHasAVX2();
+#endif
+#ifdef QATEM_NEON
+    case NeonKernel:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+void QAtemImageConverter::convertArgbToYuva(const QRgb *src, uchar *dst, int count, QAtem::ColorMatrix matrix)
+{
+    ConvertFunction convert = convertArgbToYuvaScalar;
+
+    switch(kernel())
+    {
+#ifdef QATEM_X86
+    case SSE2Kernel:
+        convert = convertArgbToYuvaSSE2;
+        break;
+    case AVX2Kernel:
+        convert = convertArgbToYuvaAVX2;
+        break;
+#endif
+#ifdef QATEM_NEON
+    case NeonKernel:
+        convert = convertArgbToYuvaNeon;
+        break;
+#endif
+    default:
+        break;
+    }
+
+    convert(src, dst, count & ~1, matrix);
+}
+
+static bool isFetchableFormat(QImage::Format format)
+{
+    switch(format)
+    {
+    case QImage::Format_ARGB32_Premultiplied:
+    case QImage::Format_ARGB32:
+    case QImage::Format_RGB32:
+    case QImage::Format_RGB888:
+    case QImage::Format_Indexed8:
+#if QT_VERSION >= QT_VERSION_CHECK(5, 2, 0)
+    case QImage::Format_RGBX8888:
+    case QImage::Format_RGBA8888:
+    case QImage::Format_RGBA8888_Premultiplied:
+#endif
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+    case QImage::Format_Grayscale8:
+#endif
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Read @p count pixels starting at @p x from row @p y of @p image as premultiplied ARGB32.
+ * @returns a pointer to the first pixel, either into @p image or into @p buffer.
+ */
+static const QRgb *fetchRow(const QImage &image, const QRgb *colorTable, int y, int x, int count, QRgb *buffer)
+{
+    const uchar *line = image.constScanLine(y);
+
+    switch(image.format())
+    {
+    case QImage::Format_ARGB32_Premultiplied:
+        return reinterpret_cast<const QRgb*>(line) + x;
+    case QImage::Format_ARGB32:
+    {
+        const QRgb *src = reinterpret_cast<const QRgb*>(line) + x;
+
+        for(int i = 0; i < count; ++i)
+        {
+            buffer[i] = qPremultiply(src[i]);
+        }
+
+        break;
+    }
+    case QImage::Format_RGB32:
+    {
+        const QRgb *src = reinterpret_cast<const QRgb*>(line) + x;
+
+        for(int i = 0; i < count; ++i)
+        {
+            buffer[i] = src[i] | 0xff000000;
+        }
+
+        break;
+    }
+    case QImage::Format_RGB888:
+    {
+        const uchar *src = line + (x * 3);
+
+        for(int i = 0; i < count; ++i, src += 3)
+        {
+            buffer[i] = qRgb(src[0], src[1], src[2]);
+        }
+
+        break;
+    }
+    case QImage::Format_Indexed8:
+    {
+        const uchar *src = line + x;
+
+        for(int i = 0; i < count; ++i)
+        {
+            buffer[i] = colorTable[src[i]];
+        }
+
+        break;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 2, 0)
+    case QImage::Format_RGBX8888:
+    case QImage::Format_RGBA8888_Premultiplied:
+    {
+        const bool opaque = image.format() == QImage::Format_RGBX8888;
+        const uchar *src = line + (x * 4);
+
+        for(int i = 0; i < count; ++i, src += 4)
+        {
+            buffer[i] = qRgba(src[0], src[1], src[2], opaque ? 0xff : src[3]);
+        }
+
+        break;
+    }
+    case QImage::Format_RGBA8888:
+    {
+        const uchar *src = line + (x * 4);
+
+        for(int i = 0; i < count; ++i, src += 4)
+        {
+            buffer[i] = qPremultiply(qRgba(src[0], src[1], src[2], src[3]));
+        }
+
+        break;
+    }
+#endif
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+    case QImage::Format_Grayscale8:
+    {
+        const uchar *src = line + x;
+
+        for(int i = 0; i < count; ++i)
+        {
+            buffer[i] = qRgb(src[i], src[i], src[i]);
+        }
+
+        break;
+    }
+#endif
+    default:
+        break;
+    }
+
+    return buffer;
+}
+
+/// Blend premultiplied pixels @p x and @p y with weights @p a and @p b that add up to 256.
+static inline QRgb interpolatePixel(QRgb x, uint a, QRgb y, uint b)
+{
+    uint t = (x & 0x00ff00ff) * a + (y & 0x00ff00ff) * b;
+    t = (t >> 8) & 0x00ff00ff;
+    x = (((x >> 8) & 0x00ff00ff) * a + ((y >> 8) & 0x00ff00ff) * b) & 0xff00ff00;
+    return x | t;
+}
+
+/// Map destination sample @p pos of @p scaledSize samples to 16.16 fixed point in a source of @p sourceSize samples.
+static inline void mapSample(int pos, int scaledSize, int sourceSize, int *index, uint *weight)
+{
+    qint64 fixed = ((qint64(2 * pos + 1) * sourceSize - scaledSize) * 32768) / scaledSize;
+    fixed = qMax(fixed, Q_INT64_C(0));
+
+    *index = static_cast<int>(fixed >> 16);
+    *weight = static_cast<uint>((fixed >> 8) & 0xff);
+
+    if(*index >= sourceSize - 1)
+    {
+        *index = sourceSize - 1;
+        *weight = 0;
+    }
+}
+
+/// Holds the two most recently fetched source rows of a band.
+struct SourceRowCache
+{
+    SourceRowCache(int count)
+    {
+        for(int i = 0; i < 2; ++i)
+        {
+            m_y[i] = -1;
+            m_row[i] = nullptr;
+            m_buffer[i].resize(count);
+        }
+    }
+
+    const QRgb *row(const QImage &image, const QRgb *colorTable, int y, int x, int count, int keep = -1)
+    {
+        for(int i = 0; i < 2; ++i)
+        {
+            if(m_y[i] == y)
+            {
+                return m_row[i];
+            }
+        }
+
+        // Rows are read top to bottom, so replace the row above unless it's still needed
+        int slot = (m_y[0] < m_y[1]) ? 0 : 1;
+
+        if(m_y[slot] == keep)
+        {
+            slot ^= 1;
+        }
+
+        m_y[slot] = y;
+        m_row[slot] = fetchRow(image, colorTable, y, x, count, m_buffer[slot].data());
+
+        return m_row[slot];
+    }
+
+    int m_y[2];
+    const QRgb *m_row[2];
+    QVector<QRgb> m_buffer[2];
+};
+
+void QAtemImageConverter::convertImage(const QImage &image, uchar *dst, int width, int height, QAtem::ImageScaleMode mode,
+                                       QAtem::ColorMatrix matrix)
+{
+    if(width <= 0 || height <= 0)
+    {
+        return;
+    }
+
+    QImage source = image;
+
+    if(!source.isNull() && !isFetchableFormat(source.format()))
+    {
+        source = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    const int sourceWidth = source.isNull() ? 0 : source.width();
+    const int sourceHeight = source.isNull() ? 0 : source.height();
+    int scaledWidth = sourceWidth;
+    int scaledHeight = sourceHeight;
+
+    if(mode != QAtem::CropImage && sourceWidth > 0 && sourceHeight > 0)
+    {
+        // Compare the width and height ratios without rounding, fit uses the smaller scale and fill the larger one
+        const bool widthLimited = (qint64(sourceHeight) * width <= qint64(sourceWidth) * height) == (mode == QAtem::FitImage);
+
+        if(widthLimited)
+        {
+            scaledWidth = width;
+            scaledHeight = static_cast<int>(qMax(Q_INT64_C(1), (qint64(sourceHeight) * width + (sourceWidth / 2)) / sourceWidth));
+        }
+        else
+        {
+            scaledHeight = height;
+            scaledWidth = static_cast<int>(qMax(Q_INT64_C(1), (qint64(sourceWidth) * height + (sourceHeight / 2)) / sourceHeight));
+        }
+    }
+
+    // The image is centered, a negative offset crops it and a positive one pads it
+    const int offsetX = (width - scaledWidth) / 2;
+    const int offsetY = (height - scaledHeight) / 2;
+    const int firstColumn = qMax(0, offsetX);
+    const int lastColumn = qMin(width, offsetX + scaledWidth);
+    const int firstRow = qMax(0, offsetY);
+    const int lastRow = qMin(height, offsetY + scaledHeight);
+    const int visibleWidth = qMax(0, lastColumn - firstColumn);
+    const bool scaled = scaledWidth != sourceWidth || scaledHeight != sourceHeight;
+
+    // Source columns are mapped once and shared by all bands, indexes are relative to the first fetched column
+    QVector<int> columnIndex(visibleWidth);
+    QVector<int> columnNext(visibleWidth);
+    QVector<uint> columnWeight(visibleWidth);
+    int fetchX = 0;
+    int fetchCount = 0;
+
+    if(visibleWidth > 0)
+    {
+        for(int i = 0; i < visibleWidth; ++i)
+        {
+            mapSample(firstColumn + i - offsetX, scaledWidth, sourceWidth, &columnIndex[i], &columnWeight[i]);
+        }
+
+        fetchX = columnIndex.first();
+        fetchCount = qMin(columnIndex.last() + 1, sourceWidth - 1) - fetchX + 1;
+
+        for(int i = 0; i < visibleWidth; ++i)
+        {
+            columnIndex[i] -= fetchX;
+            columnNext[i] = columnWeight[i] ? columnIndex[i] + 1 : columnIndex[i];
+        }
+    }
+
+    QVector<QRgb> colorTable;
+
+    if(source.format() == QImage::Format_Indexed8)
+    {
+        colorTable = source.colorTable();
+        colorTable.resize(256);
+
+        for(int i = 0; i < colorTable.size(); ++i)
+        {
+            colorTable[i] = qPremultiply(colorTable[i]);
+        }
+    }
+
+    // Pixels are converted in pairs, with an odd width a pair spans two rows so rows are converted two at a time
+    const int rowsPerStep = (width & 1) ? 2 : 1;
+    int rowsPerBand = qMax(16, height / (QThread::idealThreadCount() * 4));
+    rowsPerBand += rowsPerBand % rowsPerStep;
+
+    QVector<int> bands;
+    bands.reserve((height / rowsPerBand) + 1);
+
+    for(int row = 0; row < height; row += rowsPerBand)
+    {
+        bands.append(row);
+    }
+
+    const int *index = columnIndex.constData();
+    const int *next = columnNext.constData();
+    const uint *weight = columnWeight.constData();
+    const QRgb *table = colorTable.constData();
+
+    auto convertBand = [&](const int &bandRow) {
+        const int bandEnd = qMin(bandRow + rowsPerBand, height);
+        // Padding is never written so it stays transparent black
+        QVector<QRgb> rows(width * rowsPerStep, 0);
+        SourceRowCache cache(qMax(fetchCount, 0));
+
+        for(int row = bandRow; row < bandEnd; row += rowsPerStep)
+        {
+            const int stepRows = qMin(rowsPerStep, bandEnd - row);
+
+            for(int i = 0; i < stepRows; ++i)
+            {
+                const int y = row + i;
+                QRgb *out = rows.data() + (i * width);
+
+                if(y < firstRow || y >= lastRow || visibleWidth == 0)
+                {
+                    memset(out, 0, width * sizeof(QRgb));
+                    continue;
+                }
+
+                out += firstColumn;
+
+                if(!scaled)
+                {
+                    const QRgb *in = cache.row(source, table, y - offsetY, fetchX, fetchCount);
+                    memcpy(out, in, visibleWidth * sizeof(QRgb));
+                    continue;
+                }
+
+                int sourceY;
+                uint weightY;
+                mapSample(y - offsetY, scaledHeight, sourceHeight, &sourceY, &weightY);
+
+                const QRgb *top = cache.row(source, table, sourceY, fetchX, fetchCount);
+
+                if(weightY == 0)
+                {
+                    for(int x = 0; x < visibleWidth; ++x)
+                    {
+                        out[x] = interpolatePixel(top[index[x]], 256 - weight[x], top[next[x]], weight[x]);
+                    }
+                }
+                else
+                {
+                    const QRgb *bottom = cache.row(source, table, sourceY + 1, fetchX, fetchCount, sourceY);
+
+                    for(int x = 0; x < visibleWidth; ++x)
+                    {
+                        QRgb t = interpolatePixel(top[index[x]], 256 - weight[x], top[next[x]], weight[x]);
+                        QRgb b = interpolatePixel(bottom[index[x]], 256 - weight[x], bottom[next[x]], weight[x]);
+                        out[x] = interpolatePixel(t, 256 - weightY, b, weightY);
+                    }
+                }
+            }
+
+            convertArgbToYuva(rows.constData(), dst + (row * width * 4), stepRows * width, matrix);
+        }
+    };
+
+    if(bands.size() == 1)
+    {
+        convertBand(bands.first());
+    }
+    else
+    {
+        QtConcurrent::blockingMap(bands, convertBand);
+    }
+}
+
+/*
+ * Decoding inverts the encoding offsets, Y - 63 and C - 511 are 4 times the 8 bit studio range values, and
+ * converts back to RGB with the inverse matrix scaled by 8192:
+ *
+ * R = (Y * y + V * rV + 16384) >> 15
+ * G = (Y * y + U * gU + V * gV + 16384) >> 15
+ * B = (Y * y + U * bU + 16384) >> 15
+ * A = (A * 10 + 36) / 37, which gives back the original value for every encoded 8 bit alpha
+ *
+ * Both pixels of a pair use the U of the first and the V of the second pixel. The result is premultiplied so the
+ * colour channels are clamped to the alpha.
+ */
+
+struct DecodeCoefficients
+{
+    qint16 y;
+    qint16 rV;
+    qint16 gU, gV;
+    qint16 bU;
+};
+
+// Indexed by QAtem::ColorMatrix
+static const DecodeCoefficients s_decodeCoefficients[2] =
+{
+    { 9539, 13075, -3209, -6660, 16525 },
+    { 9539, 14686, -1747, -4366, 17305 }
+};
+
+static inline QRgb decodePixelScalar(int y, int u, int v, int a, const DecodeCoefficients &k)
+{
+    int r = (y * k.y + v * k.rV + 16384) >> 15;
+    int g = (y * k.y + u * k.gU + v * k.gV + 16384) >> 15;
+    int b = (y * k.y + u * k.bU + 16384) >> 15;
+    a = qMin((a * 10 + 36) / 37, 255);
+
+    return qRgba(qBound(0, r, a), qBound(0, g, a), qBound(0, b, a), a);
+}
+
+static void convertYuvaToArgbScalar(const uchar *src, QRgb *dst, int count, QAtem::ColorMatrix matrix)
+{
+    const DecodeCoefficients &k = s_decodeCoefficients[matrix];
+
+    for(int i = 0; i + 1 < count; i += 2)
+    {
+        const uchar *s = src + (i * 4);
+        quint32 w1 = (quint32(s[0]) << 24) | (quint32(s[1]) << 16) | (quint32(s[2]) << 8) | s[3];
+        quint32 w2 = (quint32(s[4]) << 24) | (quint32(s[5]) << 16) | (quint32(s[6]) << 8) | s[7];
+
+        int u = static_cast<int>((w1 >> 10) & 0x3ff) - 511;
+        int v = static_cast<int>((w2 >> 10) & 0x3ff) - 511;
+
+        dst[i] = decodePixelScalar(static_cast<int>(w1 & 0x3ff) - 63, u, v, static_cast<int>(w1 >> 20), k);
+        dst[i + 1] = decodePixelScalar(static_cast<int>(w2 & 0x3ff) - 63, u, v, static_cast<int>(w2 >> 20), k);
+    }
+}
+
+#ifdef QATEM_X86
+QATEM_TARGET("sse2")
+static void convertYuvaToArgbSSE2(const uchar *src, QRgb *dst, int count, QAtem::ColorMatrix matrix)
+{
+    const DecodeCoefficients &k = s_decodeCoefficients[matrix];
+    const __m128i mask10 = _mm_set1_epi32(0x3ff);
+    const __m128i mask16 = _mm_set1_epi32(0xffff);
+    const __m128i yOffset = _mm_set1_epi32(63);
+    const __m128i cOffset = _mm_set1_epi32(511);
+    // _mm_madd_epi16 multiplies Y in the low and U or V in the high half of each lane
+    const __m128i rFactors = _mm_set1_epi32(packPair(k.y, k.rV));
+    const __m128i gFactorsU = _mm_set1_epi32(packPair(0, k.gU));
+    const __m128i gFactorsV = _mm_set1_epi32(packPair(k.y, k.gV));
+    const __m128i bFactors = _mm_set1_epi32(packPair(k.y, k.bU));
+    const __m128i round = _mm_set1_epi32(16384);
+    const __m128i alphaScale = _mm_set1_epi16(10);
+    const __m128i alphaRound = _mm_set1_epi16(36);
+    const __m128i divideBy37 = _mm_set1_epi16(14170); // (x * 14170) >> 19 == x / 37 for x <= 10266
+    const __m128i maxAlpha = _mm_set1_epi16(255);
+    const __m128i zero = _mm_setzero_si128();
+
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i * 4)));
+        w = _mm_or_si128(_mm_slli_epi16(w, 8), _mm_srli_epi16(w, 8));
+        w = _mm_shufflehi_epi16(_mm_shufflelo_epi16(w, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+
+        __m128i y = _mm_and_si128(_mm_sub_epi32(_mm_and_si128(w, mask10), yOffset), mask16);
+        __m128i c = _mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(w, 10), mask10), cOffset);
+        __m128i a = _mm_srli_epi32(w, 20);
+
+        __m128i yu = _mm_or_si128(y, _mm_slli_epi32(_mm_shuffle_epi32(c, _MM_SHUFFLE(2, 2, 0, 0)), 16));
+        __m128i yv = _mm_or_si128(y, _mm_slli_epi32(_mm_shuffle_epi32(c, _MM_SHUFFLE(3, 3, 1, 1)), 16));
+
+        __m128i r = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yv, rFactors), round), 15);
+        __m128i g = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(yv, gFactorsV), _mm_madd_epi16(yu, gFactorsU)), round), 15);
+        __m128i b = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yu, bFactors), round), 15);
+
+        a = _mm_packs_epi32(a, a);
+        a = _mm_srli_epi16(_mm_mulhi_epu16(_mm_add_epi16(_mm_mullo_epi16(a, alphaScale), alphaRound), divideBy37), 3);
+        a = _mm_min_epi16(a, maxAlpha);
+
+        __m128i rg = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(r, g), zero), a);
+        __m128i bb = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(b, b), zero), a);
+
+        __m128i pixels = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_unpacklo_epi16(a, zero), 24),
+                                                   _mm_slli_epi32(_mm_unpacklo_epi16(rg, zero), 16)),
+                                      _mm_or_si128(_mm_slli_epi32(_mm_unpackhi_epi16(rg, zero), 8),
+                                                   _mm_unpacklo_epi16(bb, zero)));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), pixels);
+    }
+
+    convertYuvaToArgbScalar(src + (i * 4), dst + i, count - i, matrix);
+}
+#endif // QATEM_X86
+
+#ifdef QATEM_NEON
+static void convertYuvaToArgbNeon(const uchar *src, QRgb *dst, int count, QAtem::ColorMatrix matrix)
+{
+    const DecodeCoefficients &k = s_decodeCoefficients[matrix];
+    const uint32x4_t mask10 = vdupq_n_u32(0x3ff);
+    const int32x4_t round = vdupq_n_s32(16384);
+    const int32x4_t zero = vdupq_n_s32(0);
+
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        uint32x4_t w = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(src + (i * 4))));
+
+        int32x4_t y = vsubq_s32(vreinterpretq_s32_u32(vandq_u32(w, mask10)), vdupq_n_s32(63));
+        int32x4_t c = vsubq_s32(vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(w, 10), mask10)), vdupq_n_s32(511));
+        int32x4x2_t uv = vtrnq_s32(c, c); // U0 U0 U2 U2, V1 V1 V3 V3
+
+        int32x4_t yy = vmulq_n_s32(y, k.y);
+        int32x4_t r = vshrq_n_s32(vaddq_s32(vmlaq_n_s32(yy, uv.val[1], k.rV), round), 15);
+        int32x4_t g = vshrq_n_s32(vaddq_s32(vmlaq_n_s32(vmlaq_n_s32(yy, uv.val[0], k.gU), uv.val[1], k.gV), round), 15);
+        int32x4_t b = vshrq_n_s32(vaddq_s32(vmlaq_n_s32(yy, uv.val[0], k.bU), round), 15);
+
+        uint32x4_t a = vshrq_n_u32(w, 20);
+        a = vminq_u32(vshrq_n_u32(vmulq_n_u32(vaddq_u32(vmulq_n_u32(a, 10), vdupq_n_u32(36)), 14170), 19), vdupq_n_u32(255));
+        int32x4_t alpha = vreinterpretq_s32_u32(a);
+
+        r = vminq_s32(vmaxq_s32(r, zero), alpha);
+        g = vminq_s32(vmaxq_s32(g, zero), alpha);
+        b = vminq_s32(vmaxq_s32(b, zero), alpha);
+
+        uint32x4_t pixels = vorrq_u32(vorrq_u32(vshlq_n_u32(a, 24), vshlq_n_u32(vreinterpretq_u32_s32(r), 16)),
+                                      vorrq_u32(vshlq_n_u32(vreinterpretq_u32_s32(g), 8), vreinterpretq_u32_s32(b)));
+        vst1q_u32(dst + i, pixels);
+    }
+
+    convertYuvaToArgbScalar(src + (i * 4), dst + i, count - i, matrix);
+}
+#endif // QATEM_NEON
+
+typedef void (*DecodeFunction)(const uchar *src, QRgb *dst, int count, QAtem::ColorMatrix matrix);
+
+void QAtemImageConverter::convertYuvaToArgb(const uchar *src, QRgb *dst, int count, QAtem::ColorMatrix matrix)
+{
+    DecodeFunction convert = convertYuvaToArgbScalar;
+
+    switch(kernel())
+    {
+#ifdef QATEM_X86
+    case SSE2Kernel:
+    case AVX2Kernel:
+        convert = convertYuvaToArgbSSE2;
+        break;
+#endif
+#ifdef QATEM_NEON
+    case NeonKernel:
+        convert = convertYuvaToArgbNeon;
+        break;
+#endif
+    default:
+        break;
+    }
+
+    convert(src, dst, count & ~1, matrix);
+}
+
+void QAtemImageConverter::convertFrame(const uchar *src, int width, int height, uchar *dst, int bytesPerLine, QAtem::ColorMatrix matrix)
+{
+    if(width <= 0 || height <= 0)
+    {
+        return;
+    }
+
+    // With an odd width a pixel pair spans two rows, so rows are converted two at a time
+    const int rowsPerStep = (width & 1) ? 2 : 1;
+    const bool contiguous = bytesPerLine == width * 4;
+    int rowsPerBand = qMax(16, height / (QThread::idealThreadCount() * 4));
+    rowsPerBand += rowsPerBand % rowsPerStep;
+
+    QVector<int> bands;
+    bands.reserve((height / rowsPerBand) + 1);
+
+    for(int row = 0; row < height; row += rowsPerBand)
+    {
+        bands.append(row);
+    }
+
+    auto convertBand = [&](const int &bandRow) {
+        const int bandEnd = qMin(bandRow + rowsPerBand, height);
+
+        if(contiguous)
+        {
+            convertYuvaToArgb(src + (bandRow * width * 4), reinterpret_cast<QRgb*>(dst + (bandRow * bytesPerLine)),
+                              (bandEnd - bandRow) * width, matrix);
+            return;
+        }
+
+        QVector<QRgb> rows(width * rowsPerStep);
+
+        for(int row = bandRow; row < bandEnd; row += rowsPerStep)
+        {
+            const int stepRows = qMin(rowsPerStep, bandEnd - row);
+            convertYuvaToArgb(src + (row * width * 4), rows.data(), stepRows * width, matrix);
+
+            for(int i = 0; i < stepRows; ++i)
+            {
+                memcpy(dst + ((row + i) * bytesPerLine), rows.constData() + (i * width), width * sizeof(QRgb));
+            }
+        }
+    };
+
+    if(bands.size() == 1)
+    {
+        convertBand(bands.first());
+    }
+    else
+    {
+        QtConcurrent::blockingMap(bands, convertBand);
+    }
+}
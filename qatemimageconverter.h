@@ -0,0 +1,80 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QATEMIMAGECONVERTER_H
+#define QATEMIMAGECONVERTER_H
+
+#include "libqatemcontrol_global.h"
+#include "qatemtypes.h"
+
+#include <QtGlobal>
+#include <QColor>
+
+class QImage;
+
+/**
+ * Pixel conversion kernels used to convert images to and from the switcher's 10 bit YUVA 4:2:2 frame format.
+ * The fastest kernel supported by the CPU is selected the first time a conversion is done.
+ */
+class LIBQATEMCONTROLSHARED_EXPORT QAtemImageConverter
+{
+public:
+    enum Kernel
+    {
+        ScalarKernel = 0,
+        SSE2Kernel = 1,
+        AVX2Kernel = 2,
+        NeonKernel = 3
+    };
+
+    /// @returns the kernel used for conversions
+    static Kernel kernel();
+    /// Use @p kernel for conversions, the scalar kernel is used if @p kernel isn't supported by the CPU.
+    static void setKernel(Kernel kernel);
+    /// @returns true if @p kernel is supported by the CPU
+    static bool isKernelSupported(Kernel kernel);
+
+    /**
+     * Convert @p count premultiplied ARGB32 pixels from @p src to 10 bit YUVA 4:2:2 in @p dst using @p matrix.
+     * Pixels are converted in pairs so @p count has to be even, @p dst needs room for @p count * 4 bytes.
+     */
+    static void convertArgbToYuva(const QRgb *src, uchar *dst, int count, QAtem::ColorMatrix matrix = QAtem::Bt601Matrix);
+
+    /**
+     * Convert @p image to a @p width x @p height 10 bit YUVA 4:2:2 frame in @p dst using @p matrix.
+     * The image is centered and scaled according to @p mode, any uncovered part of the frame is transparent black.
+     * Source rows are read, resampled and converted in a single pass, in bands of rows that are converted in
+     * parallel on the global QThreadPool. @p dst needs room for @p width * @p height * 4 bytes.
+     */
+    static void convertImage(const QImage &image, uchar *dst, int width, int height, QAtem::ImageScaleMode mode = QAtem::CropImage,
+                             QAtem::ColorMatrix matrix = QAtem::Bt601Matrix);
+
+    /**
+     * Convert @p count 10 bit YUVA 4:2:2 pixels from @p src to premultiplied ARGB32 in @p dst using @p matrix.
+     * Pixels are converted in pairs so @p count has to be even.
+     */
+    static void convertYuvaToArgb(const uchar *src, QRgb *dst, int count, QAtem::ColorMatrix matrix = QAtem::Bt601Matrix);
+
+    /**
+     * Convert the @p width x @p height frame in @p src to premultiplied ARGB32 rows of @p bytesPerLine bytes in @p dst.
+     * The frame is split in bands of rows that are converted in parallel on the global QThreadPool.
+     */
+    static void convertFrame(const uchar *src, int width, int height, uchar *dst, int bytesPerLine,
+                             QAtem::ColorMatrix matrix = QAtem::Bt601Matrix);
+};
+
+#endif // QATEMIMAGECONVERTER_H
@@ -0,0 +1,372 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "qatemmediasync.h"
+#include "qatemconnection.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QTimer>
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
+
+/// Converts and hashes an entry's image the same way sendDataToSwitcher() hashes the frame.
+struct HashEntry
+{
+    HashEntry(const QSize &size, QAtem::ImageScaleMode mode, QAtem::ColorMatrix matrix) :
+        m_size(size), m_mode(mode), m_matrix(matrix) {}
+
+    typedef QAtemMediaSync::SyncEntry result_type;
+
+    QAtemMediaSync::SyncEntry operator()(const QAtemMediaSync::SyncEntry &entry) const
+    {
+        QAtemMediaSync::SyncEntry result = entry;
+        QImage image(entry.fileName);
+
+        if(image.isNull())
+        {
+            result.error = QObject::tr("Failed to load image");
+            return result;
+        }
+
+        QByteArray frame = QAtemConnection::prepImageForSwitcher(image, m_size.width(), m_size.height(), m_mode, m_matrix);
+        result.hash = QCryptographicHash::hash(frame, QCryptographicHash::Md5);
+
+        return result;
+    }
+
+    QSize m_size;
+    QAtem::ImageScaleMode m_mode;
+    QAtem::ColorMatrix m_matrix;
+};
+
+QAtemMediaSync::QAtemMediaSync(QAtemConnection *connection, QObject *parent) :
+    QObject(parent), m_connection(connection)
+{
+    m_scaleMode = QAtem::CropImage;
+    m_state = Idle;
+    m_currentUpload = 0;
+    m_transferId = 0;
+    m_locked = false;
+    m_uploadedCount = 0;
+    m_skippedCount = 0;
+
+    connect(&m_hashWatcher, SIGNAL(finished()),
+            this, SLOT(handleHashingFinished()));
+    connect(&m_frameWatcher, SIGNAL(finished()),
+            this, SLOT(uploadNext()));
+    connect(m_connection, SIGNAL(getLockStateChanged(quint8,bool)),
+            this, SLOT(handleGetLockStateChanged(quint8,bool)));
+    connect(m_connection, SIGNAL(mediaLockStateChanged(quint8,bool)),
+            this, SLOT(handleMediaLockStateChanged(quint8,bool)));
+    connect(m_connection, SIGNAL(dataTransferFinished(quint16)),
+            this, SLOT(handleDataTransferFinished(quint16)));
+    connect(m_connection, SIGNAL(dataTransferFailed(quint16)),
+            this, SLOT(handleDataTransferFailed(quint16)));
+    connect(m_connection, SIGNAL(disconnected()),
+            this, SLOT(handleDisconnected()));
+    connect(m_connection, SIGNAL(connected()),
+            this, SLOT(handleConnected()));
+}
+
+QAtemMediaSync::~QAtemMediaSync()
+{
+    m_hashWatcher.cancel();
+    m_hashWatcher.waitForFinished();
+    m_frameWatcher.waitForFinished();
+    m_nextFrame.waitForFinished();
+}
+
+bool QAtemMediaSync::syncDirectory(const QString &path, quint8 firstIndex)
+{
+    QDir dir(path);
+    QStringList filters;
+    filters << "*.png" << "*.jpg" << "*.jpeg" << "*.bmp" << "*.tif" << "*.tiff" << "*.gif";
+    QFileInfoList files = dir.entryInfoList(filters, QDir::Files | QDir::Readable, QDir::Name);
+
+    int stillCount = m_connection->mediaPoolStillBankCount() ? m_connection->mediaPoolStillBankCount() : 256;
+    QMap<quint8, QString> map;
+
+    for(int i = 0; i < files.count() && (firstIndex + i) < stillCount; ++i)
+    {
+        map.insert(static_cast<quint8>(firstIndex + i), files.at(i).absoluteFilePath());
+    }
+
+    if(map.isEmpty())
+    {
+        return false;
+    }
+
+    return sync(map);
+}
+
+bool QAtemMediaSync::sync(const QMap<quint8, QString> &files)
+{
+    if(m_state != Idle)
+    {
+        return false;
+    }
+
+    QList<SyncEntry> entries;
+
+    for(QMap<quint8, QString>::const_iterator it = files.constBegin(); it != files.constEnd(); ++it)
+    {
+        SyncEntry entry;
+        entry.index = it.key();
+        entry.fileName = it.value();
+        entry.name = QFileInfo(it.value()).baseName().toUtf8();
+        entries.append(entry);
+    }
+
+    m_uploads.clear();
+    m_currentUpload = 0;
+    m_uploadedCount = 0;
+    m_skippedCount = 0;
+    m_state = Hashing;
+
+    HashEntry hashEntry(m_connection->currentVideoMode().size, m_scaleMode, m_connection->colorMatrix());
+    m_hashWatcher.setFuture(QtConcurrent::mapped(entries, hashEntry));
+
+    return true;
+}
+
+void QAtemMediaSync::cancel()
+{
+    if(m_state == Hashing)
+    {
+        m_hashWatcher.cancel();
+    }
+
+    // Let the upload in progress finish, the lock is released when it's done
+    m_uploads = m_uploads.mid(0, m_currentUpload + 1);
+
+    if(m_state != Uploading || m_transferId == 0)
+    {
+        finish();
+    }
+}
+
+void QAtemMediaSync::handleHashingFinished()
+{
+    if(m_state != Hashing)
+    {
+        return;
+    }
+
+    if(m_hashWatcher.isCanceled())
+    {
+        finish();
+        return;
+    }
+
+    QList<SyncEntry> entries = m_hashWatcher.future().results();
+
+    foreach(const SyncEntry &entry, entries)
+    {
+        if(!entry.error.isEmpty())
+        {
+            emit stillFailed(entry.index, entry.fileName, entry.error);
+            continue;
+        }
+
+        QAtem::MediaInfo info = m_connection->stillMediaInfo(entry.index);
+
+        if(info.used && info.hash == entry.hash)
+        {
+            ++m_skippedCount;
+            emit stillSkipped(entry.index, entry.fileName);
+
+            if(info.name != QString::fromUtf8(entry.name))
+            {
+                emit stillNameMismatch(entry.index, info.name, QString::fromUtf8(entry.name));
+            }
+
+            continue;
+        }
+
+        m_uploads.append(entry);
+    }
+
+    if(m_uploads.isEmpty())
+    {
+        finish();
+        return;
+    }
+
+    // Convert the first frame while waiting for the lock
+    prepareFrame(0);
+    m_frameWatcher.setFuture(m_nextFrame);
+
+    m_state = AquiringLock;
+
+    if(!m_connection->mediaLockState(0))
+    {
+        m_connection->aquireMediaLock(0, m_uploads.first().index);
+    }
+}
+
+void QAtemMediaSync::handleGetLockStateChanged(quint8 storeId, bool state)
+{
+    if(storeId != 0 || m_state != AquiringLock || !state)
+    {
+        return;
+    }
+
+    m_locked = true;
+    m_state = Uploading;
+    uploadNext();
+}
+
+void QAtemMediaSync::handleMediaLockStateChanged(quint8 id, bool state)
+{
+    // The lock state is broadcast to every client, it only tells when someone else has released the lock
+    if(id == 0 && !state && m_state == AquiringLock)
+    {
+        m_connection->aquireMediaLock(0, m_uploads.at(m_currentUpload).index);
+    }
+}
+
+void QAtemMediaSync::prepareFrame(int upload)
+{
+    if(upload < m_uploads.count())
+    {
+        const QString fileName = m_uploads.at(upload).fileName;
+        const QSize size = m_connection->currentVideoMode().size;
+        const QAtem::ImageScaleMode mode = m_scaleMode;
+        const QAtem::ColorMatrix matrix = m_connection->colorMatrix();
+
+        m_nextFrame = QtConcurrent::run([=]() {
+            return QAtemConnection::prepImageForSwitcher(QImage(fileName), size.width(), size.height(), mode, matrix);
+        });
+    }
+    else
+    {
+        m_nextFrame = QFuture<QByteArray>();
+    }
+}
+
+void QAtemMediaSync::uploadNext()
+{
+    if(m_state != Uploading || m_transferId != 0 || !m_frameWatcher.isFinished())
+    {
+        return;
+    }
+
+    if(m_currentUpload >= m_uploads.count())
+    {
+        finish();
+        return;
+    }
+
+    // Only one transfer can run at a time
+    if(m_connection->transferActive())
+    {
+        QTimer::singleShot(100, this, SLOT(uploadNext()));
+        return;
+    }
+
+    const SyncEntry &entry = m_uploads.at(m_currentUpload);
+    m_transferId = m_connection->sendDataToSwitcher(0, entry.index, entry.name, m_frameWatcher.result());
+
+    if(m_transferId == 0)
+    {
+        QTimer::singleShot(100, this, SLOT(uploadNext()));
+        return;
+    }
+
+    // Convert the next frame while this one uploads
+    prepareFrame(m_currentUpload + 1);
+}
+
+void QAtemMediaSync::handleDataTransferFinished(quint16 transferId)
+{
+    if(m_state != Uploading || transferId != m_transferId)
+    {
+        return;
+    }
+
+    const SyncEntry &entry = m_uploads.at(m_currentUpload);
+    ++m_uploadedCount;
+    emit stillUploaded(entry.index, entry.fileName);
+
+    m_transferId = 0;
+    ++m_currentUpload;
+
+    if(m_currentUpload >= m_uploads.count())
+    {
+        finish();
+        return;
+    }
+
+    m_frameWatcher.setFuture(m_nextFrame);
+}
+
+void QAtemMediaSync::handleDataTransferFailed(quint16 transferId)
+{
+    if(m_state != Uploading || transferId != m_transferId)
+    {
+        return;
+    }
+
+    const SyncEntry &entry = m_uploads.at(m_currentUpload);
+    emit stillFailed(entry.index, entry.fileName, tr("The transfer failed"));
+
+    m_transferId = 0;
+    finish();
+}
+
+void QAtemMediaSync::handleDisconnected()
+{
+    // The switcher drops the lock with the session. The connection restarts a transfer in progress under a new
+    // lock by itself, between transfers the lock has to be requested again when the connection is back.
+    if(m_state == AquiringLock || (m_state == Uploading && m_transferId == 0))
+    {
+        m_locked = false;
+        m_state = AquiringLock;
+    }
+}
+
+void QAtemMediaSync::handleConnected()
+{
+    if(m_state == AquiringLock && !m_connection->mediaLockState(0))
+    {
+        m_connection->aquireMediaLock(0, m_uploads.at(m_currentUpload).index);
+    }
+}
+
+void QAtemMediaSync::finish()
+{
+    if(m_state == Idle)
+    {
+        return;
+    }
+
+    // Also release a lock that was requested but not granted yet, a lost session has released it already
+    if((m_locked || m_state == AquiringLock) && m_connection->isConnected())
+    {
+        m_connection->unlockMediaLock(0);
+    }
+
+    m_locked = false;
+    m_state = Idle;
+    m_transferId = 0;
+    m_uploads.clear();
+
+    emit syncFinished(m_uploadedCount, m_skippedCount);
+}
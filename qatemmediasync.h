@@ -0,0 +1,121 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QATEMMEDIASYNC_H
+#define QATEMMEDIASYNC_H
+
+#include "libqatemcontrol_global.h"
+#include "qatemtypes.h"
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QList>
+#include <QMap>
+
+class QAtemConnection;
+
+/**
+ * Syncs image files to the still store of the media pool.
+ * All files are converted and hashed in parallel first, and only the stills whose MD5 differs from the hash the
+ * switcher reports are uploaded. Uploads are done one at a time as the switcher only handles one transfer at a
+ * time, the next frame is converted while the current one uploads.
+ */
+class LIBQATEMCONTROLSHARED_EXPORT QAtemMediaSync : public QObject
+{
+    Q_OBJECT
+public:
+    struct SyncEntry
+    {
+        quint8 index;
+        QString fileName;
+        QByteArray name;
+        QByteArray hash;
+        QString error;
+    };
+
+    explicit QAtemMediaSync(QAtemConnection *connection, QObject *parent = nullptr);
+    ~QAtemMediaSync();
+
+    /// How images that don't match the frame size are scaled. Defaults to QAtem::CropImage.
+    void setScaleMode(QAtem::ImageScaleMode mode) { m_scaleMode = mode; }
+    QAtem::ImageScaleMode scaleMode() const { return m_scaleMode; }
+
+    /**
+     * Sync the images in @p path to the still store in file name order, starting at still @p firstIndex.
+     * @returns false if a sync is already running or the directory has no images
+     */
+    bool syncDirectory(const QString &path, quint8 firstIndex = 0);
+    /// Sync the image files in @p files to the stills they're mapped to. @returns false if a sync is already running.
+    bool sync(const QMap<quint8, QString> &files);
+    /// Stop the sync after the upload in progress
+    void cancel();
+
+    bool isRunning() const { return m_state != Idle; }
+
+protected slots:
+    void handleHashingFinished();
+    void handleGetLockStateChanged(quint8 storeId, bool state);
+    void handleMediaLockStateChanged(quint8 id, bool state);
+    void handleDataTransferFinished(quint16 transferId);
+    void handleDataTransferFailed(quint16 transferId);
+    void handleDisconnected();
+    void handleConnected();
+
+    void uploadNext();
+
+private:
+    enum State
+    {
+        Idle,
+        Hashing,
+        AquiringLock,
+        Uploading
+    };
+
+    void prepareFrame(int upload);
+    void finish();
+
+    QAtemConnection *m_connection;
+    QAtem::ImageScaleMode m_scaleMode;
+    State m_state;
+
+    QFutureWatcher<SyncEntry> m_hashWatcher;
+    QFutureWatcher<QByteArray> m_frameWatcher;
+    QFuture<QByteArray> m_nextFrame;
+
+    QList<SyncEntry> m_uploads;
+    int m_currentUpload;
+    quint16 m_transferId;
+    bool m_locked;
+
+    int m_uploadedCount;
+    int m_skippedCount;
+
+signals:
+    /// Still @p index already holds the content of @p fileName and wasn't uploaded
+    void stillSkipped(quint8 index, const QString &fileName);
+    void stillUploaded(quint8 index, const QString &fileName);
+    /**
+     * Still @p index holds the content of @p fileName but is named @p switcherName.
+     * The protocol has no command to rename a still, the still has to be uploaded again to change the name.
+     */
+    void stillNameMismatch(quint8 index, const QString &switcherName, const QString &localName);
+    void stillFailed(quint8 index, const QString &fileName, const QString &errorString);
+    void syncFinished(int uploadedCount, int skippedCount);
+};
+
+#endif // QATEMMEDIASYNC_H
@@ -18,6 +18,29 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include "qatemmixeffect.h"
 
 #include <QColor>
+#include <QTimer>
+
+/// @returns @p value in the fixed point units of the protocol, @p scale units per unit
+static inline qint32 fixedPoint(float value, int scale)
+{
+    return qRound(value * scale);
+}
+
+static inline void writeU16(QByteArray &payload, int offset, qint32 value)
+{
+    QAtem::U16_U8 val;
+    val.u16 = static_cast<quint16>(value);
+    payload[offset] = static_cast<char>(val.u8[1]);
+    payload[offset + 1] = static_cast<char>(val.u8[0]);
+}
+
+static inline void writeU32(QByteArray &payload, int offset, quint32 value)
+{
+    payload[offset] = static_cast<char>((value >> 24) & 0xff);
+    payload[offset + 1] = static_cast<char>((value >> 16) & 0xff);
+    payload[offset + 2] = static_cast<char>((value >> 8) & 0xff);
+    payload[offset + 3] = static_cast<char>(value & 0xff);
+}
 
 QAtemMixEffect::QAtemMixEffect(quint8 id, QAtemConnection *parent) :
     QObject(parent), m_id(id), m_atemConnection(parent)
@@ -28,10 +51,20 @@ QAtemMixEffect::QAtemMixEffect(quint8 id, QAtemConnection *parent) :
     m_transitionPreviewEnabled = false;
     m_transitionFrameCount = 0;
     m_transitionPosition = 0;
+    m_inTransition = false;
+    m_transitionVelocity = 0;
+    m_transitionStreamingEnabled = false;
+    m_streamedTransitionPosition = 0;
+    m_sentTransitionPosition = 0;
+    m_transitionPositionPending = false;
+    m_transitionStreamTimer = new QTimer(this);
+    connect(m_transitionStreamTimer, SIGNAL(timeout()),
+            this, SLOT(flushTransitionPosition()));
     m_keyersOnCurrentTransition = 0;
     m_currentTransitionStyle = 0;
     m_keyersOnNextTransition = 0;
     m_nextTransitionStyle = 0;
+    m_queuedKeyersOnNextTransition = 0;
 
     m_fadeToBlackEnabled = false;
     m_fadeToBlackFading = false;
@@ -76,34 +109,34 @@ QAtemMixEffect::QAtemMixEffect(quint8 id, QAtemConnection *parent) :
     m_stingerTriggerPoint = 0;
     m_stingerMixRate = 0;
 
-    m_atemConnection->registerCommand("PrgI", this, "onPrgI");
-    m_atemConnection->registerCommand("PrvI", this, "onPrvI");
+    m_atemConnection->registerCommand("PrgI", this, "onPrgI", m_id);
+    m_atemConnection->registerCommand("PrvI", this, "onPrvI", m_id);
 
-    m_atemConnection->registerCommand("TrPr", this, "onTrPr");
-    m_atemConnection->registerCommand("TrPs", this, "onTrPs");
-    m_atemConnection->registerCommand("TrSS", this, "onTrSS");
+    m_atemConnection->registerCommand("TrPr", this, "onTrPr", m_id);
+    m_atemConnection->registerCommand("TrPs", this, "onTrPs", m_id);
+    m_atemConnection->registerCommand("TrSS", this, "onTrSS", m_id);
 
-    m_atemConnection->registerCommand("FtbS", this, "onFtbS");
-    m_atemConnection->registerCommand("FtbP", this, "onFtbP");
+    m_atemConnection->registerCommand("FtbS", this, "onFtbS", m_id);
+    m_atemConnection->registerCommand("FtbP", this, "onFtbP", m_id);
 
-    m_atemConnection->registerCommand("TMxP", this, "onTMxP");
+    m_atemConnection->registerCommand("TMxP", this, "onTMxP", m_id);
 
-    m_atemConnection->registerCommand("TDpP", this, "onTDpP");
+    m_atemConnection->registerCommand("TDpP", this, "onTDpP", m_id);
 
-    m_atemConnection->registerCommand("TWpP", this, "onTWpP");
+    m_atemConnection->registerCommand("TWpP", this, "onTWpP", m_id);
 
-    m_atemConnection->registerCommand("TDvP", this, "onTDvP");
+    m_atemConnection->registerCommand("TDvP", this, "onTDvP", m_id);
 
-    m_atemConnection->registerCommand("TStP", this, "onTStP");
+    m_atemConnection->registerCommand("TStP", this, "onTStP", m_id);
 
-    m_atemConnection->registerCommand("KeOn", this, "onKeOn");
-    m_atemConnection->registerCommand("KeBP", this, "onKeBP");
-    m_atemConnection->registerCommand("KeLm", this, "onKeLm");
-    m_atemConnection->registerCommand("KeCk", this, "onKeCk");
-    m_atemConnection->registerCommand("KePt", this, "onKePt");
-    m_atemConnection->registerCommand("KeDV", this, "onKeDV");
-    m_atemConnection->registerCommand("KeFS", this, "onKeFS");
-    m_atemConnection->registerCommand("KKFP", this, "onKKFP");
+    m_atemConnection->registerCommand("KeOn", this, "onKeOn", m_id);
+    m_atemConnection->registerCommand("KeBP", this, "onKeBP", m_id);
+    m_atemConnection->registerCommand("KeLm", this, "onKeLm", m_id);
+    m_atemConnection->registerCommand("KeCk", this, "onKeCk", m_id);
+    m_atemConnection->registerCommand("KePt", this, "onKePt", m_id);
+    m_atemConnection->registerCommand("KeDV", this, "onKeDV", m_id);
+    m_atemConnection->registerCommand("KeFS", this, "onKeFS", m_id);
+    m_atemConnection->registerCommand("KKFP", this, "onKKFP", m_id);
 }
 
 QAtemMixEffect::~QAtemMixEffect()
@@ -174,11 +207,6 @@ void QAtemMixEffect::autoTransition()
 
 void QAtemMixEffect::changeProgramInput(quint16 index)
 {
-    if(index == m_programInput)
-    {
-        return;
-    }
-
     QByteArray cmd("CPgI");
     QByteArray payload(4, 0x0);
     QAtem::U16_U8 val;
@@ -188,16 +216,152 @@ void QAtemMixEffect::changeProgramInput(quint16 index)
     payload[2] = static_cast<char>(val.u8[1]);
     payload[3] = static_cast<char>(val.u8[0]);
 
+    if(index == m_programInput)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
+
+    if(m_atemConnection->optimisticUpdatesEnabled())
+    {
+        quint16 old = m_programInput;
+        m_atemConnection->addPendingUpdate(updateKey("PrgI"), this, index, old);
+        m_programInput = index;
+        emit programInputChanged(m_id, old, m_programInput);
+    }
 }
 
 void QAtemMixEffect::setTransitionPosition(quint16 position)
 {
+    if(m_transitionStreamingEnabled)
+    {
+        m_streamedTransitionPosition = position;
+
+        if(position == 0 || position == 10000)
+        {
+            m_transitionStreamTimer->stop();
+            m_transitionPositionPending = true;
+            flushTransitionPosition();
+        }
+        else if(!m_transitionStreamTimer->isActive())
+        {
+            // Leading edge, send right away and hold back the following positions for a frame
+            float fps = m_atemConnection->currentVideoMode().framesPerSecond;
+            m_transitionStreamTimer->setInterval(fps > 0 ? qMax(1, qRound(1000.0f / fps)) : 40);
+            m_transitionStreamTimer->start();
+            m_transitionPositionPending = true;
+            flushTransitionPosition();
+        }
+        else
+        {
+            m_transitionPositionPending = true;
+        }
+
+        return;
+    }
+
     if(position == m_transitionPosition)
     {
         return;
     }
 
+    sendTransitionPosition(position);
+}
+
+quint16 QAtemMixEffect::predictedTransitionPosition() const
+{
+    if(!m_inTransition || m_transitionVelocity <= 0 || !m_transitionClock.isValid())
+    {
+        return m_transitionPosition;
+    }
+
+    float position = m_transitionPosition + (m_transitionVelocity * m_transitionClock.elapsed());
+
+    return static_cast<quint16>(qMin(position, 10000.0f));
+}
+
+QByteArray QAtemMixEffect::updateKey(const char *command) const
+{
+    return QByteArray(command).append(static_cast<char>(m_id));
+}
+
+void QAtemMixEffect::rollbackUpdate(const QByteArray &key, const QVariant &value)
+{
+    QByteArray command = key.left(4);
+
+    if(command == "PrgI")
+    {
+        quint16 old = m_programInput;
+        m_programInput = static_cast<quint16>(value.toUInt());
+        emit programInputChanged(m_id, old, m_programInput);
+    }
+    else if(command == "PrvI")
+    {
+        quint16 old = m_previewInput;
+        m_previewInput = static_cast<quint16>(value.toUInt());
+        emit previewInputChanged(m_id, old, m_previewInput);
+    }
+    else if(command == "TrPr")
+    {
+        m_transitionPreviewEnabled = value.toBool();
+        emit transitionPreviewChanged(m_id, m_transitionPreviewEnabled);
+    }
+}
+
+quint16 QAtemMixEffect::currentTransitionRate() const
+{
+    switch(m_currentTransitionStyle)
+    {
+    case 0:
+        return m_mixFrames;
+    case 1:
+        return m_dipFrames;
+    case 2:
+        return m_wipeFrames;
+    case 3:
+        return m_dveRate;
+    case 4:
+        return m_stingerClipDuration;
+    default:
+        return 0;
+    }
+}
+
+void QAtemMixEffect::setTransitionPositionStreamingEnabled(bool enabled)
+{
+    if(!enabled && m_transitionStreamTimer->isActive())
+    {
+        m_transitionStreamTimer->stop();
+        flushTransitionPosition();
+    }
+
+    m_transitionStreamingEnabled = enabled;
+    m_sentTransitionPosition = m_transitionPosition;
+}
+
+void QAtemMixEffect::flushTransitionPosition()
+{
+    if(!m_transitionPositionPending)
+    {
+        // Nothing new during the last frame, the fader is idle
+        m_transitionStreamTimer->stop();
+        return;
+    }
+
+    m_transitionPositionPending = false;
+
+    if(m_streamedTransitionPosition != m_sentTransitionPosition)
+    {
+        sendTransitionPosition(m_streamedTransitionPosition);
+    }
+}
+
+void QAtemMixEffect::sendTransitionPosition(quint16 position)
+{
+    m_sentTransitionPosition = position;
+
     QByteArray cmd("CTPs");
     QByteArray payload(4, 0x0);
     QAtem::U16_U8 val;
@@ -213,11 +377,6 @@ void QAtemMixEffect::setTransitionPosition(quint16 position)
 
 void QAtemMixEffect::changePreviewInput(quint16 index)
 {
-    if(index == m_previewInput)
-    {
-        return;
-    }
-
     QByteArray cmd("CPvI");
     QByteArray payload(4, 0x0);
     QAtem::U16_U8 val;
@@ -227,23 +386,45 @@ void QAtemMixEffect::changePreviewInput(quint16 index)
     payload[2] = static_cast<char>(val.u8[1]);
     payload[3] = static_cast<char>(val.u8[0]);
 
+    if(index == m_previewInput)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
-}
 
-void QAtemMixEffect::setTransitionPreview(bool state)
-{
-    if(state == m_transitionPreviewEnabled)
+    if(m_atemConnection->optimisticUpdatesEnabled())
     {
-        return;
+        quint16 old = m_previewInput;
+        m_atemConnection->addPendingUpdate(updateKey("PrvI"), this, index, old);
+        m_previewInput = index;
+        emit previewInputChanged(m_id, old, m_previewInput);
     }
+}
 
+void QAtemMixEffect::setTransitionPreview(bool state)
+{
     QByteArray cmd("CTPr");
     QByteArray payload(4, 0x0);
 
     payload[0] = static_cast<char>(m_id);
     payload[1] = static_cast<char>(state);
 
+    if(state == m_transitionPreviewEnabled)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
+
+    if(m_atemConnection->optimisticUpdatesEnabled())
+    {
+        m_atemConnection->addPendingUpdate(updateKey("TrPr"), this, state, m_transitionPreviewEnabled);
+        m_transitionPreviewEnabled = state;
+        emit transitionPreviewChanged(m_id, m_transitionPreviewEnabled);
+    }
 }
 
 void QAtemMixEffect::setTransitionType(quint8 type)
@@ -255,6 +436,12 @@ void QAtemMixEffect::setTransitionType(quint8 type)
     payload[1] = static_cast<char>(m_id);
     payload[2] = static_cast<char>(type);
 
+    if(m_atemConnection->inTransaction() && type == m_nextTransitionStyle)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
@@ -273,7 +460,15 @@ void QAtemMixEffect::setKeyOnNextTransition (int index, bool state)
     QByteArray cmd("CTTp");
     QByteArray payload(4, 0x0);
 
-    quint8 stateValue = keyersOnNextTransition();
+    quint8 current = keyersOnNextTransition();
+
+    // Build on the keyers already queued, the switcher hasn't reported them yet
+    if(m_atemConnection->inTransaction() && m_keyerTransaction == m_atemConnection->currentTransaction())
+    {
+        current = m_queuedKeyersOnNextTransition;
+    }
+
+    quint8 stateValue = current;
 
     if(state)
     {
@@ -284,13 +479,13 @@ void QAtemMixEffect::setKeyOnNextTransition (int index, bool state)
         stateValue &= (~(0x1 << index));
     }
 
-    if(stateValue == keyersOnNextTransition())
+    if(stateValue == current)
     {
         return;
     }
     else if(stateValue == 0)
     {
-        emit keyersOnNextTransitionChanged(m_id, keyersOnNextTransition());
+        emit keyersOnNextTransitionChanged(m_id, current);
         return;
     }
 
@@ -299,6 +494,12 @@ void QAtemMixEffect::setKeyOnNextTransition (int index, bool state)
     payload[3] = static_cast<char>(stateValue & 0x1f);
 
     m_atemConnection->sendCommand(cmd, payload);
+
+    if(m_atemConnection->inTransaction())
+    {
+        m_keyerTransaction = m_atemConnection->currentTransaction();
+        m_queuedKeyersOnNextTransition = stateValue;
+    }
 }
 
 void QAtemMixEffect::toggleFadeToBlack()
@@ -314,11 +515,6 @@ void QAtemMixEffect::toggleFadeToBlack()
 
 void QAtemMixEffect::setFadeToBlackFrameRate(quint8 frames)
 {
-    if(frames == m_fadeToBlackFrameCount)
-    {
-        return;
-    }
-
     QByteArray cmd("FtbC");
     QByteArray payload(4, 0x0);
 
@@ -326,6 +522,12 @@ void QAtemMixEffect::setFadeToBlackFrameRate(quint8 frames)
     payload[1] = static_cast<char>(m_id);
     payload[2] = static_cast<char>(frames);
 
+    if(frames == m_fadeToBlackFrameCount)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
@@ -406,7 +608,7 @@ void QAtemMixEffect::setWipeBorderWidth(quint16 width)
     payload[6] = static_cast<char>(val.u8[1]);
     payload[7] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setWipeBorderSoftness(quint16 softness)
@@ -421,7 +623,7 @@ void QAtemMixEffect::setWipeBorderSoftness(quint16 softness)
     payload[12] = static_cast<char>(val.u8[1]);
     payload[13] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setWipeType(quint8 type)
@@ -448,7 +650,7 @@ void QAtemMixEffect::setWipeSymmetry(quint16 value)
     payload[10] = static_cast<char>(val.u8[1]);
     payload[11] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setWipeXPosition(quint16 value)
@@ -463,7 +665,7 @@ void QAtemMixEffect::setWipeXPosition(quint16 value)
     payload[14] = static_cast<char>(val.u8[1]);
     payload[15] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setWipeYPosition(quint16 value)
@@ -478,7 +680,7 @@ void QAtemMixEffect::setWipeYPosition(quint16 value)
     payload[16] = static_cast<char>(val.u8[1]);
     payload[17] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setWipeReverseDirection(bool reverse)
@@ -598,7 +800,7 @@ void QAtemMixEffect::setDVEKeyClip(float percent)
     payload[12] = static_cast<char>(val.u8[1]);
     payload[13] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setDVEKeyGain(float percent)
@@ -613,7 +815,7 @@ void QAtemMixEffect::setDVEKeyGain(float percent)
     payload[14] = static_cast<char>(val.u8[1]);
     payload[15] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setDVEInvertKeyEnabled(bool enabled)
@@ -688,7 +890,7 @@ void QAtemMixEffect::setStingerClip(float percent)
     payload[6] = static_cast<char>(val.u8[1]);
     payload[7] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setStingerGain(float percent)
@@ -703,7 +905,7 @@ void QAtemMixEffect::setStingerGain(float percent)
     payload[8] = static_cast<char>(val.u8[1]);
     payload[9] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setStingerInvertKeyEnabled(bool enabled)
@@ -730,7 +932,7 @@ void QAtemMixEffect::setStingerPreRoll(quint16 frames)
     payload[12] = static_cast<char>(val.u8[1]);
     payload[13] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setStingerClipDuration(quint16 frames)
@@ -745,7 +947,7 @@ void QAtemMixEffect::setStingerClipDuration(quint16 frames)
     payload[14] = static_cast<char>(val.u8[1]);
     payload[15] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setStingerTriggerPoint(quint16 frames)
@@ -760,7 +962,7 @@ void QAtemMixEffect::setStingerTriggerPoint(quint16 frames)
     payload[16] = static_cast<char>(val.u8[1]);
     payload[17] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setStingerMixRate(quint16 frames)
@@ -775,16 +977,11 @@ void QAtemMixEffect::setStingerMixRate(quint16 frames)
     payload[18] = static_cast<char>(val.u8[1]);
     payload[19] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setUpstreamKeyOnAir(quint8 keyer, bool state)
 {
-    if(state == m_upstreamKeys[keyer]->m_onAir)
-    {
-        return;
-    }
-
     QByteArray cmd("CKOn");
     QByteArray payload(4, 0x0);
 
@@ -792,6 +989,12 @@ void QAtemMixEffect::setUpstreamKeyOnAir(quint8 keyer, bool state)
     payload[1] = static_cast<char>(keyer);
     payload[2] = static_cast<char>(state);
 
+    if(state == m_upstreamKeys[keyer]->m_onAir)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
@@ -809,7 +1012,7 @@ bool QAtemMixEffect::upstreamKeyOnAir(quint8 keyer) const
 
 void QAtemMixEffect::setUpstreamKeyType(quint8 keyer, quint8 type)
 {
-    if(keyer >= m_upstreamKeys.count() || type == m_upstreamKeys[keyer]->m_type)
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -822,12 +1025,18 @@ void QAtemMixEffect::setUpstreamKeyType(quint8 keyer, quint8 type)
     payload[2] = static_cast<char>(keyer);
     payload[3] = static_cast<char>(type);
 
+    if(type == m_upstreamKeys[keyer]->m_type)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
 void QAtemMixEffect::setUpstreamKeyFillSource(quint8 keyer, quint16 source)
 {
-    if(keyer >= m_upstreamKeys.count() || source == m_upstreamKeys[keyer]->m_fillSource)
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -842,12 +1051,18 @@ void QAtemMixEffect::setUpstreamKeyFillSource(quint8 keyer, quint16 source)
     payload[2] = static_cast<char>(val.u8[1]);
     payload[3] = static_cast<char>(val.u8[0]);
 
+    if(source == m_upstreamKeys[keyer]->m_fillSource)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
 void QAtemMixEffect::setUpstreamKeyKeySource(quint8 keyer, quint16 source)
 {
-    if(keyer >= m_upstreamKeys.count() || source == m_upstreamKeys[keyer]->m_keySource)
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -862,12 +1077,18 @@ void QAtemMixEffect::setUpstreamKeyKeySource(quint8 keyer, quint16 source)
     payload[2] = static_cast<char>(val.u8[1]);
     payload[3] = static_cast<char>(val.u8[0]);
 
+    if(source == m_upstreamKeys[keyer]->m_keySource)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
 void QAtemMixEffect::setUpstreamKeyEnableMask(quint8 keyer, bool enable)
 {
-    if(keyer >= m_upstreamKeys.count() || enable == m_upstreamKeys[keyer]->m_enableMask)
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -880,6 +1101,12 @@ void QAtemMixEffect::setUpstreamKeyEnableMask(quint8 keyer, bool enable)
     payload[2] = static_cast<char>(keyer);
     payload[3] = enable;
 
+    if(enable == m_upstreamKeys[keyer]->m_enableMask)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
@@ -905,12 +1132,12 @@ void QAtemMixEffect::setUpstreamKeyMask(quint8 keyer, float top, float bottom, f
     payload[10] = static_cast<char>(val.u8[1]);
     payload[11] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setUpstreamKeyLumaPreMultipliedKey(quint8 keyer, bool preMultiplied)
 {
-    if(keyer >= m_upstreamKeys.count() || preMultiplied == m_upstreamKeys[keyer]->m_lumaPreMultipliedKey)
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -923,12 +1150,18 @@ void QAtemMixEffect::setUpstreamKeyLumaPreMultipliedKey(quint8 keyer, bool preMu
     payload[2] = static_cast<char>(keyer);
     payload[3] = preMultiplied;
 
+    if(preMultiplied == m_upstreamKeys[keyer]->m_lumaPreMultipliedKey)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
 void QAtemMixEffect::setUpstreamKeyLumaInvertKey(quint8 keyer, bool invert)
 {
-    if(keyer >= m_upstreamKeys.count() || invert == m_upstreamKeys[keyer]->m_lumaInvertKey)
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -941,12 +1174,18 @@ void QAtemMixEffect::setUpstreamKeyLumaInvertKey(quint8 keyer, bool invert)
     payload[2] = static_cast<char>(keyer);
     payload[8] = invert;
 
+    if(invert == m_upstreamKeys[keyer]->m_lumaInvertKey)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
 void QAtemMixEffect::setUpstreamKeyLumaClip(quint8 keyer, float clip)
 {
-    if(keyer >= m_upstreamKeys.count() || qFuzzyCompare(clip, m_upstreamKeys[keyer]->m_lumaClip))
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -962,12 +1201,18 @@ void QAtemMixEffect::setUpstreamKeyLumaClip(quint8 keyer, float clip)
     payload[4] = static_cast<char>(val.u8[1]);
     payload[5] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    if(qFuzzyCompare(clip, m_upstreamKeys[keyer]->m_lumaClip))
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setUpstreamKeyLumaGain(quint8 keyer, float gain)
 {
-    if(keyer >= m_upstreamKeys.count() || qFuzzyCompare(gain, m_upstreamKeys[keyer]->m_lumaGain))
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -983,12 +1228,18 @@ void QAtemMixEffect::setUpstreamKeyLumaGain(quint8 keyer, float gain)
     payload[6] = static_cast<char>(val.u8[1]);
     payload[7] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    if(qFuzzyCompare(gain, m_upstreamKeys[keyer]->m_lumaGain))
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setUpstreamKeyChromaHue(quint8 keyer, float hue)
 {
-    if(keyer >= m_upstreamKeys.count() || qFuzzyCompare(hue, m_upstreamKeys[keyer]->m_chromaHue))
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -1004,12 +1255,18 @@ void QAtemMixEffect::setUpstreamKeyChromaHue(quint8 keyer, float hue)
     payload[4] = static_cast<char>(val.u8[1]);
     payload[5] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    if(qFuzzyCompare(hue, m_upstreamKeys[keyer]->m_chromaHue))
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setUpstreamKeyChromaGain(quint8 keyer, float gain)
 {
-    if(keyer >= m_upstreamKeys.count() || qFuzzyCompare(gain,  m_upstreamKeys[keyer]->m_chromaGain))
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -1025,12 +1282,18 @@ void QAtemMixEffect::setUpstreamKeyChromaGain(quint8 keyer, float gain)
     payload[6] = static_cast<char>(val.u8[1]);
     payload[7] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    if(qFuzzyCompare(gain,  m_upstreamKeys[keyer]->m_chromaGain))
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setUpstreamKeyChromaYSuppress(quint8 keyer, float ySuppress)
 {
-    if(keyer >= m_upstreamKeys.count() || qFuzzyCompare(ySuppress, m_upstreamKeys[keyer]->m_chromaYSuppress))
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -1046,12 +1309,18 @@ void QAtemMixEffect::setUpstreamKeyChromaYSuppress(quint8 keyer, float ySuppress
     payload[8] = static_cast<char>(val.u8[1]);
     payload[9] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    if(qFuzzyCompare(ySuppress, m_upstreamKeys[keyer]->m_chromaYSuppress))
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setUpstreamKeyChromaLift(quint8 keyer, float lift)
 {
-    if(keyer >= m_upstreamKeys.count() || qFuzzyCompare(lift, m_upstreamKeys[keyer]->m_chromaLift))
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -1067,12 +1336,18 @@ void QAtemMixEffect::setUpstreamKeyChromaLift(quint8 keyer, float lift)
     payload[10] = static_cast<char>(val.u8[1]);
     payload[11] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    if(qFuzzyCompare(lift, m_upstreamKeys[keyer]->m_chromaLift))
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setUpstreamKeyChromaNarrowRange(quint8 keyer, bool narrowRange)
 {
-    if(keyer >= m_upstreamKeys.count() || narrowRange == m_upstreamKeys[keyer]->m_chromaNarrowRange)
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -1085,12 +1360,18 @@ void QAtemMixEffect::setUpstreamKeyChromaNarrowRange(quint8 keyer, bool narrowRa
     payload[2] = static_cast<char>(keyer);
     payload[12] = narrowRange;
 
+    if(narrowRange == m_upstreamKeys[keyer]->m_chromaNarrowRange)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
 void QAtemMixEffect::setUpstreamKeyPatternPattern(quint8 keyer, quint8 pattern)
 {
-    if(keyer >= m_upstreamKeys.count() || pattern == m_upstreamKeys[keyer]->m_patternPattern)
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -1103,12 +1384,18 @@ void QAtemMixEffect::setUpstreamKeyPatternPattern(quint8 keyer, quint8 pattern)
     payload[2] = static_cast<char>(keyer);
     payload[3] = static_cast<char>(pattern);
 
+    if(pattern == m_upstreamKeys[keyer]->m_patternPattern)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
 void QAtemMixEffect::setUpstreamKeyPatternInvertPattern(quint8 keyer, bool invert)
 {
-    if(keyer >= m_upstreamKeys.count() || invert == m_upstreamKeys[keyer]->m_patternInvertPattern)
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -1121,12 +1408,18 @@ void QAtemMixEffect::setUpstreamKeyPatternInvertPattern(quint8 keyer, bool inver
     payload[2] = static_cast<char>(keyer);
     payload[14] = invert;
 
+    if(invert == m_upstreamKeys[keyer]->m_patternInvertPattern)
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
     m_atemConnection->sendCommand(cmd, payload);
 }
 
 void QAtemMixEffect::setUpstreamKeyPatternSize(quint8 keyer, float size)
 {
-    if(keyer >= m_upstreamKeys.count() || qFuzzyCompare(size, m_upstreamKeys[keyer]->m_patternSize))
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -1142,12 +1435,18 @@ void QAtemMixEffect::setUpstreamKeyPatternSize(quint8 keyer, float size)
     payload[4] = static_cast<char>(val.u8[1]);
     payload[5] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    if(qFuzzyCompare(size, m_upstreamKeys[keyer]->m_patternSize))
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setUpstreamKeyPatternSymmetry(quint8 keyer, float symmetry)
 {
-    if(keyer >= m_upstreamKeys.count() || qFuzzyCompare(symmetry, m_upstreamKeys[keyer]->m_patternSymmetry))
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -1163,12 +1462,18 @@ void QAtemMixEffect::setUpstreamKeyPatternSymmetry(quint8 keyer, float symmetry)
     payload[6] = static_cast<char>(val.u8[1]);
     payload[7] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    if(qFuzzyCompare(symmetry, m_upstreamKeys[keyer]->m_patternSymmetry))
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setUpstreamKeyPatternSoftness(quint8 keyer, float softness)
 {
-    if(keyer >= m_upstreamKeys.count() || qFuzzyCompare(softness, m_upstreamKeys[keyer]->m_patternSoftness))
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -1184,12 +1489,18 @@ void QAtemMixEffect::setUpstreamKeyPatternSoftness(quint8 keyer, float softness)
     payload[8] = static_cast<char>(val.u8[1]);
     payload[9] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    if(qFuzzyCompare(softness, m_upstreamKeys[keyer]->m_patternSoftness))
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setUpstreamKeyPatternXPosition(quint8 keyer, float xPosition)
 {
-    if(keyer >= m_upstreamKeys.count() || qFuzzyCompare(xPosition, m_upstreamKeys[keyer]->m_patternXPosition))
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -1205,12 +1516,18 @@ void QAtemMixEffect::setUpstreamKeyPatternXPosition(quint8 keyer, float xPositio
     payload[10] = static_cast<char>(val.u8[1]);
     payload[11] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    if(qFuzzyCompare(xPosition, m_upstreamKeys[keyer]->m_patternXPosition))
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setUpstreamKeyPatternYPosition(quint8 keyer, float yPosition)
 {
-    if(keyer >= m_upstreamKeys.count() || qFuzzyCompare(yPosition, m_upstreamKeys[keyer]->m_patternYPosition))
+    if(keyer >= m_upstreamKeys.count())
     {
         return;
     }
@@ -1226,7 +1543,13 @@ void QAtemMixEffect::setUpstreamKeyPatternYPosition(quint8 keyer, float yPositio
     payload[12] = static_cast<char>(val.u8[1]);
     payload[13] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    if(qFuzzyCompare(yPosition, m_upstreamKeys[keyer]->m_patternYPosition))
+    {
+        m_atemConnection->dropQueuedCommand(cmd, payload);
+        return;
+    }
+
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 3);
 }
 
 void QAtemMixEffect::setUpstreamKeyDVEPosition(quint8 keyer, float xPosition, float yPosition)
@@ -1245,7 +1568,7 @@ void QAtemMixEffect::setUpstreamKeyDVEPosition(quint8 keyer, float xPosition, fl
     payload[22] = static_cast<char>(val.u8[1]);
     payload[23] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 6);
 }
 
 void QAtemMixEffect::setUpstreamKeyDVESize(quint8 keyer, float xSize, float ySize)
@@ -1264,7 +1587,7 @@ void QAtemMixEffect::setUpstreamKeyDVESize(quint8 keyer, float xSize, float ySiz
     payload[14] = static_cast<char>(val.u8[1]);
     payload[15] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 6);
 }
 
 void QAtemMixEffect::setUpstreamKeyDVERotation(quint8 keyer, float rotation)
@@ -1280,7 +1603,7 @@ void QAtemMixEffect::setUpstreamKeyDVERotation(quint8 keyer, float rotation)
     payload[26] = static_cast<char>(val.u8[1]);
     payload[27] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 6);
 }
 
 void QAtemMixEffect::setUpstreamKeyDVELightSource(quint8 keyer, float direction, quint8 altitude)
@@ -1297,7 +1620,7 @@ void QAtemMixEffect::setUpstreamKeyDVELightSource(quint8 keyer, float direction,
     payload[49] = static_cast<char>(val.u8[0]);
     payload[50] = static_cast<char>(altitude);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 6);
 }
 
 void QAtemMixEffect::setUpstreamKeyDVEDropShadowEnabled(quint8 keyer, bool enabled)
@@ -1352,7 +1675,7 @@ void QAtemMixEffect::setUpstreamKeyDVEBorderColorH(quint8 keyer, float h)
     payload[42] = static_cast<char>(val.u8[1]);
     payload[43] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 6);
 }
 
 void QAtemMixEffect::setUpstreamKeyDVEBorderColorS(quint8 keyer, float s)
@@ -1368,7 +1691,7 @@ void QAtemMixEffect::setUpstreamKeyDVEBorderColorS(quint8 keyer, float s)
     payload[44] = static_cast<char>(val.u8[1]);
     payload[45] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 6);
 }
 
 void QAtemMixEffect::setUpstreamKeyDVEBorderColorL(quint8 keyer, float l)
@@ -1384,7 +1707,7 @@ void QAtemMixEffect::setUpstreamKeyDVEBorderColorL(quint8 keyer, float l)
     payload[46] = static_cast<char>(val.u8[1]);
     payload[47] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 6);
 }
 
 void QAtemMixEffect::setUpstreamKeyDVEBorderColor(quint8 keyer, const QColor& color)
@@ -1410,7 +1733,7 @@ void QAtemMixEffect::setUpstreamKeyDVEBorderWidth(quint8 keyer, float outside, f
     payload[34] = static_cast<char>(val.u8[1]);
     payload[35] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 6);
 }
 
 void QAtemMixEffect::setUpstreamKeyDVEBorderSoften(quint8 keyer, quint8 outside, quint8 inside)
@@ -1450,7 +1773,7 @@ void QAtemMixEffect::setUpstreamKeyDVEBorderBevelPosition(quint8 keyer, float po
     payload[5] = static_cast<char>(keyer);
     payload[39] = static_cast<char>(position * 100);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 6);
 }
 
 void QAtemMixEffect::setUpstreamKeyDVEBorderBevelSoften(quint8 keyer, float soften)
@@ -1463,7 +1786,7 @@ void QAtemMixEffect::setUpstreamKeyDVEBorderBevelSoften(quint8 keyer, float soft
     payload[5] = static_cast<char>(keyer);
     payload[38] = static_cast<char>(soften * 100);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 6);
 }
 
 void QAtemMixEffect::setUpstreamKeyDVERate(quint8 keyer, quint8 rate)
@@ -1559,7 +1882,434 @@ void QAtemMixEffect::setUpstreamKeyDVEMask(quint8 keyer, float top, float bottom
     payload[58] = static_cast<char>(val.u8[1]);
     payload[59] = static_cast<char>(val.u8[0]);
 
-    m_atemConnection->sendCommand(cmd, payload);
+    m_atemConnection->sendCoalescedCommand(cmd, payload, 6);
+}
+
+QUpstreamKeySettings QAtemMixEffect::upstreamKeySettings(quint8 keyer) const
+{
+    if(keyer < m_upstreamKeys.count())
+    {
+        return *m_upstreamKeys[keyer];
+    }
+
+    return QUpstreamKeySettings(keyer);
+}
+
+void QAtemMixEffect::applyUpstreamKeySettings(quint8 keyer, const QUpstreamKeySettings &settings)
+{
+    if(keyer >= m_upstreamKeys.count())
+    {
+        return;
+    }
+
+    const QUpstreamKeySettings &current = *m_upstreamKeys[keyer];
+    bool ownTransaction = !m_atemConnection->inTransaction();
+    QAtemTransaction *transaction = m_atemConnection->beginTransaction();
+
+    // Values from the continuous setters still waiting to be sent would override the settings applied here
+    QByteArray indexes(2, 0x0);
+    indexes[0] = static_cast<char>(m_id);
+    indexes[1] = static_cast<char>(keyer);
+    m_atemConnection->dropCoalescedCommands("CKMs", 1, indexes);
+    m_atemConnection->dropCoalescedCommands("CKLm", 1, indexes);
+    m_atemConnection->dropCoalescedCommands("CKCk", 1, indexes);
+    m_atemConnection->dropCoalescedCommands("CKPt", 1, indexes);
+    m_atemConnection->dropCoalescedCommands("CKDV", 4, indexes);
+
+    // Type
+    QByteArray type(8, 0x0);
+    quint8 typeMask = 0;
+
+    if(settings.m_type != current.m_type)
+    {
+        typeMask |= 0x01;
+        type[3] = static_cast<char>(settings.m_type);
+    }
+
+    if(settings.m_enableFly != current.m_enableFly)
+    {
+        typeMask |= 0x02;
+        type[4] = settings.m_enableFly;
+    }
+
+    if(typeMask)
+    {
+        type[0] = static_cast<char>(typeMask);
+        type[1] = static_cast<char>(m_id);
+        type[2] = static_cast<char>(keyer);
+        m_atemConnection->sendCommand("CKTp", type);
+    }
+
+    // Sources
+    if(settings.m_fillSource != current.m_fillSource)
+    {
+        QByteArray payload(4, 0x0);
+        payload[0] = static_cast<char>(m_id);
+        payload[1] = static_cast<char>(keyer);
+        writeU16(payload, 2, settings.m_fillSource);
+        m_atemConnection->sendCommand("CKeF", payload);
+    }
+
+    if(settings.m_keySource != current.m_keySource)
+    {
+        QByteArray payload(4, 0x0);
+        payload[0] = static_cast<char>(m_id);
+        payload[1] = static_cast<char>(keyer);
+        writeU16(payload, 2, settings.m_keySource);
+        m_atemConnection->sendCommand("CKeC", payload);
+    }
+
+    // Mask
+    QByteArray mask(12, 0x0);
+    quint8 maskMask = 0;
+
+    if(settings.m_enableMask != current.m_enableMask)
+    {
+        maskMask |= 0x01;
+        mask[3] = settings.m_enableMask;
+    }
+
+    if(fixedPoint(settings.m_topMask, 1000) != fixedPoint(current.m_topMask, 1000))
+    {
+        maskMask |= 0x02;
+        writeU16(mask, 4, fixedPoint(settings.m_topMask, 1000));
+    }
+
+    if(fixedPoint(settings.m_bottomMask, 1000) != fixedPoint(current.m_bottomMask, 1000))
+    {
+        maskMask |= 0x04;
+        writeU16(mask, 6, fixedPoint(settings.m_bottomMask, 1000));
+    }
+
+    if(fixedPoint(settings.m_leftMask, 1000) != fixedPoint(current.m_leftMask, 1000))
+    {
+        maskMask |= 0x08;
+        writeU16(mask, 8, fixedPoint(settings.m_leftMask, 1000));
+    }
+
+    if(fixedPoint(settings.m_rightMask, 1000) != fixedPoint(current.m_rightMask, 1000))
+    {
+        maskMask |= 0x10;
+        writeU16(mask, 10, fixedPoint(settings.m_rightMask, 1000));
+    }
+
+    if(maskMask)
+    {
+        mask[0] = static_cast<char>(maskMask);
+        mask[1] = static_cast<char>(m_id);
+        mask[2] = static_cast<char>(keyer);
+        m_atemConnection->sendCommand("CKMs", mask);
+    }
+
+    // Luma
+    QByteArray luma(12, 0x0);
+    quint8 lumaMask = 0;
+
+    if(settings.m_lumaPreMultipliedKey != current.m_lumaPreMultipliedKey)
+    {
+        lumaMask |= 0x01;
+        luma[3] = settings.m_lumaPreMultipliedKey;
+    }
+
+    if(fixedPoint(settings.m_lumaClip, 10) != fixedPoint(current.m_lumaClip, 10))
+    {
+        lumaMask |= 0x02;
+        writeU16(luma, 4, fixedPoint(settings.m_lumaClip, 10));
+    }
+
+    if(fixedPoint(settings.m_lumaGain, 10) != fixedPoint(current.m_lumaGain, 10))
+    {
+        lumaMask |= 0x04;
+        writeU16(luma, 6, fixedPoint(settings.m_lumaGain, 10));
+    }
+
+    if(settings.m_lumaInvertKey != current.m_lumaInvertKey)
+    {
+        lumaMask |= 0x08;
+        luma[8] = settings.m_lumaInvertKey;
+    }
+
+    if(lumaMask)
+    {
+        luma[0] = static_cast<char>(lumaMask);
+        luma[1] = static_cast<char>(m_id);
+        luma[2] = static_cast<char>(keyer);
+        m_atemConnection->sendCommand("CKLm", luma);
+    }
+
+    // Chroma
+    QByteArray chroma(16, 0x0);
+    quint8 chromaMask = 0;
+
+    if(fixedPoint(settings.m_chromaHue, 10) != fixedPoint(current.m_chromaHue, 10))
+    {
+        chromaMask |= 0x01;
+        writeU16(chroma, 4, fixedPoint(settings.m_chromaHue, 10));
+    }
+
+    if(fixedPoint(settings.m_chromaGain, 10) != fixedPoint(current.m_chromaGain, 10))
+    {
+        chromaMask |= 0x02;
+        writeU16(chroma, 6, fixedPoint(settings.m_chromaGain, 10));
+    }
+
+    if(fixedPoint(settings.m_chromaYSuppress, 10) != fixedPoint(current.m_chromaYSuppress, 10))
+    {
+        chromaMask |= 0x04;
+        writeU16(chroma, 8, fixedPoint(settings.m_chromaYSuppress, 10));
+    }
+
+    if(fixedPoint(settings.m_chromaLift, 10) != fixedPoint(current.m_chromaLift, 10))
+    {
+        chromaMask |= 0x08;
+        writeU16(chroma, 10, fixedPoint(settings.m_chromaLift, 10));
+    }
+
+    if(settings.m_chromaNarrowRange != current.m_chromaNarrowRange)
+    {
+        chromaMask |= 0x10;
+        chroma[12] = settings.m_chromaNarrowRange;
+    }
+
+    if(chromaMask)
+    {
+        chroma[0] = static_cast<char>(chromaMask);
+        chroma[1] = static_cast<char>(m_id);
+        chroma[2] = static_cast<char>(keyer);
+        m_atemConnection->sendCommand("CKCk", chroma);
+    }
+
+    // Pattern
+    QByteArray pattern(16, 0x0);
+    quint8 patternMask = 0;
+
+    if(settings.m_patternPattern != current.m_patternPattern)
+    {
+        patternMask |= 0x01;
+        pattern[3] = static_cast<char>(settings.m_patternPattern);
+    }
+
+    if(fixedPoint(settings.m_patternSize, 100) != fixedPoint(current.m_patternSize, 100))
+    {
+        patternMask |= 0x02;
+        writeU16(pattern, 4, fixedPoint(settings.m_patternSize, 100));
+    }
+
+    if(fixedPoint(settings.m_patternSymmetry, 100) != fixedPoint(current.m_patternSymmetry, 100))
+    {
+        patternMask |= 0x04;
+        writeU16(pattern, 6, fixedPoint(settings.m_patternSymmetry, 100));
+    }
+
+    if(fixedPoint(settings.m_patternSoftness, 100) != fixedPoint(current.m_patternSoftness, 100))
+    {
+        patternMask |= 0x08;
+        writeU16(pattern, 8, fixedPoint(settings.m_patternSoftness, 100));
+    }
+
+    if(fixedPoint(settings.m_patternXPosition, 1000) != fixedPoint(current.m_patternXPosition, 1000))
+    {
+        patternMask |= 0x10;
+        writeU16(pattern, 10, fixedPoint(settings.m_patternXPosition, 1000));
+    }
+
+    if(fixedPoint(settings.m_patternYPosition, 1000) != fixedPoint(current.m_patternYPosition, 1000))
+    {
+        patternMask |= 0x20;
+        writeU16(pattern, 12, fixedPoint(settings.m_patternYPosition, 1000));
+    }
+
+    if(settings.m_patternInvertPattern != current.m_patternInvertPattern)
+    {
+        patternMask |= 0x40;
+        pattern[14] = settings.m_patternInvertPattern;
+    }
+
+    if(patternMask)
+    {
+        pattern[0] = static_cast<char>(patternMask);
+        pattern[1] = static_cast<char>(m_id);
+        pattern[2] = static_cast<char>(keyer);
+        m_atemConnection->sendCommand("CKPt", pattern);
+    }
+
+    // DVE, the field mask is 32 bits and the size, position and rotation are signed 32 bit values
+    QByteArray dve(64, 0x0);
+    quint32 dveMask = 0;
+
+    if(fixedPoint(settings.m_dveXSize, 1000) != fixedPoint(current.m_dveXSize, 1000))
+    {
+        dveMask |= 0x00000001;
+        writeU32(dve, 8, static_cast<quint32>(fixedPoint(settings.m_dveXSize, 1000)));
+    }
+
+    if(fixedPoint(settings.m_dveYSize, 1000) != fixedPoint(current.m_dveYSize, 1000))
+    {
+        dveMask |= 0x00000002;
+        writeU32(dve, 12, static_cast<quint32>(fixedPoint(settings.m_dveYSize, 1000)));
+    }
+
+    if(fixedPoint(settings.m_dveXPosition, 1000) != fixedPoint(current.m_dveXPosition, 1000))
+    {
+        dveMask |= 0x00000004;
+        writeU32(dve, 16, static_cast<quint32>(fixedPoint(settings.m_dveXPosition, 1000)));
+    }
+
+    if(fixedPoint(settings.m_dveYPosition, 1000) != fixedPoint(current.m_dveYPosition, 1000))
+    {
+        dveMask |= 0x00000008;
+        writeU32(dve, 20, static_cast<quint32>(fixedPoint(settings.m_dveYPosition, 1000)));
+    }
+
+    if(fixedPoint(settings.m_dveRotation, 10) != fixedPoint(current.m_dveRotation, 10))
+    {
+        dveMask |= 0x00000010;
+        writeU32(dve, 24, static_cast<quint32>(fixedPoint(settings.m_dveRotation, 10)));
+    }
+
+    if(settings.m_dveEnableBorder != current.m_dveEnableBorder)
+    {
+        dveMask |= 0x00000020;
+        dve[28] = settings.m_dveEnableBorder;
+    }
+
+    if(settings.m_dveEnableDropShadow != current.m_dveEnableDropShadow)
+    {
+        dveMask |= 0x00000040;
+        dve[29] = settings.m_dveEnableDropShadow;
+    }
+
+    if(settings.m_dveBorderStyle != current.m_dveBorderStyle)
+    {
+        dveMask |= 0x00000080;
+        dve[30] = static_cast<char>(settings.m_dveBorderStyle);
+    }
+
+    if(fixedPoint(settings.m_dveBorderOutsideWidth, 100) != fixedPoint(current.m_dveBorderOutsideWidth, 100))
+    {
+        dveMask |= 0x00000100;
+        writeU16(dve, 32, fixedPoint(settings.m_dveBorderOutsideWidth, 100));
+    }
+
+    if(fixedPoint(settings.m_dveBorderInsideWidth, 100) != fixedPoint(current.m_dveBorderInsideWidth, 100))
+    {
+        dveMask |= 0x00000200;
+        writeU16(dve, 34, fixedPoint(settings.m_dveBorderInsideWidth, 100));
+    }
+
+    if(settings.m_dveBorderOutsideSoften != current.m_dveBorderOutsideSoften)
+    {
+        dveMask |= 0x00000400;
+        dve[36] = static_cast<char>(settings.m_dveBorderOutsideSoften);
+    }
+
+    if(settings.m_dveBorderInsideSoften != current.m_dveBorderInsideSoften)
+    {
+        dveMask |= 0x00000800;
+        dve[37] = static_cast<char>(settings.m_dveBorderInsideSoften);
+    }
+
+    if(fixedPoint(settings.m_dveBorderBevelSoften, 100) != fixedPoint(current.m_dveBorderBevelSoften, 100))
+    {
+        dveMask |= 0x00001000;
+        dve[38] = static_cast<char>(fixedPoint(settings.m_dveBorderBevelSoften, 100));
+    }
+
+    if(fixedPoint(settings.m_dveBorderBevelPosition, 100) != fixedPoint(current.m_dveBorderBevelPosition, 100))
+    {
+        dveMask |= 0x00002000;
+        dve[39] = static_cast<char>(fixedPoint(settings.m_dveBorderBevelPosition, 100));
+    }
+
+    if(settings.m_dveBorderOpacity != current.m_dveBorderOpacity)
+    {
+        dveMask |= 0x00004000;
+        dve[40] = static_cast<char>(settings.m_dveBorderOpacity);
+    }
+
+    // Same conversion as setUpstreamKeyDVEBorderColor()
+    qint32 hue = fixedPoint(static_cast<float>(qMax(0.0, settings.m_dveBorderColor.hslHueF()) * 360.0), 10);
+    qint32 saturation = fixedPoint(static_cast<float>(settings.m_dveBorderColor.hslSaturationF() * 100), 10);
+    qint32 lightness = fixedPoint(static_cast<float>(settings.m_dveBorderColor.lightnessF() * 100), 10);
+
+    if(hue != fixedPoint(static_cast<float>(qMax(0.0, current.m_dveBorderColor.hslHueF()) * 360.0), 10))
+    {
+        dveMask |= 0x00008000;
+        writeU16(dve, 42, hue);
+    }
+
+    if(saturation != fixedPoint(static_cast<float>(current.m_dveBorderColor.hslSaturationF() * 100), 10))
+    {
+        dveMask |= 0x00010000;
+        writeU16(dve, 44, saturation);
+    }
+
+    if(lightness != fixedPoint(static_cast<float>(current.m_dveBorderColor.lightnessF() * 100), 10))
+    {
+        dveMask |= 0x00020000;
+        writeU16(dve, 46, lightness);
+    }
+
+    if(fixedPoint(settings.m_dveLightSourceDirection, 10) != fixedPoint(current.m_dveLightSourceDirection, 10))
+    {
+        dveMask |= 0x00040000;
+        writeU16(dve, 48, fixedPoint(settings.m_dveLightSourceDirection, 10));
+    }
+
+    if(settings.m_dveLightSourceAltitude != current.m_dveLightSourceAltitude)
+    {
+        dveMask |= 0x00080000;
+        dve[50] = static_cast<char>(settings.m_dveLightSourceAltitude);
+    }
+
+    if(settings.m_dveMaskEnabled != current.m_dveMaskEnabled)
+    {
+        dveMask |= 0x00100000;
+        dve[51] = settings.m_dveMaskEnabled;
+    }
+
+    if(fixedPoint(settings.m_dveMaskTop, 1000) != fixedPoint(current.m_dveMaskTop, 1000))
+    {
+        dveMask |= 0x00200000;
+        writeU16(dve, 52, fixedPoint(settings.m_dveMaskTop, 1000));
+    }
+
+    if(fixedPoint(settings.m_dveMaskBottom, 1000) != fixedPoint(current.m_dveMaskBottom, 1000))
+    {
+        dveMask |= 0x00400000;
+        writeU16(dve, 54, fixedPoint(settings.m_dveMaskBottom, 1000));
+    }
+
+    if(fixedPoint(settings.m_dveMaskLeft, 1000) != fixedPoint(current.m_dveMaskLeft, 1000))
+    {
+        dveMask |= 0x00800000;
+        writeU16(dve, 56, fixedPoint(settings.m_dveMaskLeft, 1000));
+    }
+
+    if(fixedPoint(settings.m_dveMaskRight, 1000) != fixedPoint(current.m_dveMaskRight, 1000))
+    {
+        dveMask |= 0x01000000;
+        writeU16(dve, 58, fixedPoint(settings.m_dveMaskRight, 1000));
+    }
+
+    if(settings.m_dveRate != current.m_dveRate)
+    {
+        dveMask |= 0x02000000;
+        dve[60] = static_cast<char>(settings.m_dveRate);
+    }
+
+    if(dveMask)
+    {
+        writeU32(dve, 0, dveMask);
+        dve[4] = static_cast<char>(m_id);
+        dve[5] = static_cast<char>(keyer);
+        m_atemConnection->sendCommand("CKDV", dve);
+    }
+
+    if(ownTransaction)
+    {
+        transaction->commit();
+    }
 }
 
 void QAtemMixEffect::onPrgI(const QByteArray& payload)
@@ -1572,6 +2322,12 @@ void QAtemMixEffect::onPrgI(const QByteArray& payload)
         QAtem::U16_U8 val;
         val.u8[1] = static_cast<quint8>(payload.at(8));
         val.u8[0] = static_cast<quint8>(payload.at(9));
+
+        if(!m_atemConnection->reconcileUpdate(updateKey("PrgI"), val.u16))
+        {
+            return;
+        }
+
         m_programInput = val.u16;
         emit programInputChanged(m_id, old, m_programInput);
     }
@@ -1587,6 +2343,12 @@ void QAtemMixEffect::onPrvI(const QByteArray& payload)
         QAtem::U16_U8 val;
         val.u8[1] = static_cast<quint8>(payload.at(8));
         val.u8[0] = static_cast<quint8>(payload.at(9));
+
+        if(!m_atemConnection->reconcileUpdate(updateKey("PrvI"), val.u16))
+        {
+            return;
+        }
+
         m_previewInput = val.u16;
         emit previewInputChanged(m_id, old, m_previewInput);
     }
@@ -1598,7 +2360,14 @@ void QAtemMixEffect::onTrPr(const QByteArray& payload)
 
     if(me == m_id)
     {
-        m_transitionPreviewEnabled = payload.at(7);
+        bool enabled = payload.at(7);
+
+        if(!m_atemConnection->reconcileUpdate(updateKey("TrPr"), enabled))
+        {
+            return;
+        }
+
+        m_transitionPreviewEnabled = enabled;
 
         emit transitionPreviewChanged(m_id, m_transitionPreviewEnabled);
     }
@@ -1610,9 +2379,40 @@ void QAtemMixEffect::onTrPs(const QByteArray& payload)
 
     if(me == m_id)
     {
+        bool wasInTransition = m_inTransition;
+        quint8 previousFrameCount = m_transitionFrameCount;
+        m_inTransition = payload.at(7);
         m_transitionFrameCount = static_cast<quint8>(payload.at(8));
         m_transitionPosition = static_cast<quint16>(static_cast<quint8>(payload.at(11)) | (static_cast<quint8>(payload.at(10)) << 8));
 
+        // Auto transitions and other clients move the position too, echoes of a running stream lag behind it
+        if(!m_transitionStreamTimer->isActive())
+        {
+            m_sentTransitionPosition = m_transitionPosition;
+        }
+
+        // Only auto transitions count down frames, positions set from a fader can't be predicted
+        m_transitionVelocity = 0;
+
+        if(m_inTransition && (!wasInTransition || m_transitionFrameCount < previousFrameCount))
+        {
+            float fps = m_atemConnection->currentVideoMode().framesPerSecond;
+            float position = m_transitionPosition;
+            float framesLeft = m_transitionFrameCount;
+
+            if(framesLeft <= 0)
+            {
+                framesLeft = currentTransitionRate() * (10000 - position) / 10000;
+            }
+
+            if(fps > 0 && framesLeft > 0)
+            {
+                m_transitionVelocity = (10000 - position) / (framesLeft * 1000 / fps);
+            }
+        }
+
+        m_transitionClock.start();
+
         emit transitionFrameCountChanged(m_id, m_transitionFrameCount);
         emit transitionPositionChanged(m_id, m_transitionPosition);
     }
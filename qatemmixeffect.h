@@ -22,8 +22,10 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include <qupstreamkeysettings.h>
 
 #include <QObject>
+#include <QElapsedTimer>
 
 class QColor;
+class QTimer;
 
 class LIBQATEMCONTROLSHARED_EXPORT QAtemMixEffect : public QObject
 {
@@ -45,6 +47,17 @@ public:
     quint8 transitionFrameCount() const { return m_transitionFrameCount; }
     /// @returns percent left of transition
     quint16 transitionPosition() const { return m_transitionPosition; }
+    /// @returns true while a transition is running
+    bool inTransition() const { return m_inTransition; }
+    /**
+     * @returns the transition position predicted for now. While an auto transition runs the position is
+     * extrapolated from the last position reported by the switcher, using the frames left of the transition, or
+     * the rate of the current transition style, and the frame rate of the video mode. Every position reported by
+     * the switcher corrects the prediction. Cheap enough to be called at the display's refresh rate.
+     */
+    quint16 predictedTransitionPosition() const;
+    /// @returns true if setTransitionPosition() sends at most one position per video frame
+    bool transitionPositionStreamingEnabled() const { return m_transitionStreamingEnabled; }
     /// @returns keyers used on next transition. Bit 0 = Background, 1-4 = keys, only bit 0 and 1 available on TVS
     quint8 keyersOnNextTransition() const { return m_keyersOnNextTransition; }
     /// @returns index of selected transition style for next transition. Bit 0 = Mix, 1 = Dip, 2 = Wipe, 3 = DVE and 4 = Stinger, only bit 0-2 available on TVS
@@ -169,6 +182,8 @@ public:
 
     /// @returns number of upstream keys available on this M/E
     quint8 upstreamKeyCount() const { return static_cast<quint8>(m_upstreamKeys.count()); }
+    /// @returns a copy of the settings of upstream key @p keyer
+    QUpstreamKeySettings upstreamKeySettings(quint8 keyer) const;
     /// @returns true if upstream key @p keyer is on air
     bool upstreamKeyOnAir(quint8 keyer) const;
     /// @returns the key type for upstream key @p keyer, 0 = luma, 1 = chroma, 2 = pattern, 3 = DVE
@@ -280,6 +295,13 @@ public slots:
 
     /// Set the current position of the transition to @p position. Set @p position to 0 to signal transition done.
     void setTransitionPosition(quint16 position);
+    /**
+     * Enable streaming of transition positions, for faders polled faster than the video frame rate.
+     * The first position after the fader has been idle is sent immediately, after that only the latest position is
+     * sent once per frame of the current video mode. Positions 0 and 10000 are sent immediately, any other position
+     * the fader comes to rest on is sent at the end of its frame.
+     */
+    void setTransitionPositionStreamingEnabled(bool enabled);
     void setTransitionPreview(bool state);
     void setTransitionType(quint8 type);
     void setUpstreamKeyOnNextTransition(quint8 keyer, bool state);
@@ -443,7 +465,18 @@ public slots:
     void setUpstreamKeyDVEMaskEnabled(quint8 keyer, bool enable);
     void setUpstreamKeyDVEMask(quint8 keyer, float top, float bottom, float left, float right);
 
+    /**
+     * Change upstream key @p keyer to @p settings. Only the fields that differ from the current settings are sent,
+     * merged into one command per settings group, and the commands are sent in a single transaction unless a
+     * transaction is already open. The on air state, the key frames and the ID in @p settings are ignored.
+     */
+    void applyUpstreamKeySettings(quint8 keyer, const QUpstreamKeySettings &settings);
+
 protected slots:
+    void flushTransitionPosition();
+    /// Restore the state identified by @p key to @p value when an optimistic update wasn't confirmed in time
+    void rollbackUpdate(const QByteArray &key, const QVariant &value);
+
     void onPrgI(const QByteArray& payload);
     void onPrvI(const QByteArray& payload);
 
@@ -475,6 +508,11 @@ protected slots:
 
 protected:
     void setKeyOnNextTransition (int index, bool state);
+    /// @returns the key identifying the state set by @p command on this mix effect for optimistic updates
+    QByteArray updateKey(const char *command) const;
+    /// @returns the duration in frames of the current transition style
+    quint16 currentTransitionRate() const;
+    void sendTransitionPosition(quint16 position);
 
 private:
     quint8 m_id;
@@ -486,10 +524,20 @@ private:
     bool m_transitionPreviewEnabled;
     quint8 m_transitionFrameCount;
     quint16 m_transitionPosition;
+    bool m_inTransition;
+    QElapsedTimer m_transitionClock;
+    float m_transitionVelocity; // Position units per millisecond
+    bool m_transitionStreamingEnabled;
+    QTimer *m_transitionStreamTimer;
+    quint16 m_streamedTransitionPosition;
+    quint16 m_sentTransitionPosition;
+    bool m_transitionPositionPending;
     quint8 m_keyersOnCurrentTransition;
     quint8 m_currentTransitionStyle;
     quint8 m_keyersOnNextTransition;
     quint8 m_nextTransitionStyle;
+    QPointer<QAtemTransaction> m_keyerTransaction;
+    quint8 m_queuedKeyersOnNextTransition; // Keyers on next transition queued in m_keyerTransaction
 
     bool m_fadeToBlackEnabled;
     bool m_fadeToBlackFading;
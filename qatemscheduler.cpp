@@ -0,0 +1,262 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "qatemscheduler.h"
+#include "qatemconnection.h"
+#include "qatemswitcherclock.h"
+
+#include <math.h>
+
+QAtemScheduler::QAtemScheduler(QAtemConnection *connection, QObject *parent) :
+    QObject(parent), m_connection(connection)
+{
+    m_nextId = 1;
+    m_leadTime = 5;
+
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, SIGNAL(timeout()),
+            this, SLOT(processCues()));
+
+    m_switcherClock = new QAtemSwitcherClock(connection, this);
+    connect(m_switcherClock, SIGNAL(validChanged(bool)),
+            this, SIGNAL(lockedChanged(bool)));
+    connect(m_switcherClock, SIGNAL(validChanged(bool)),
+            this, SLOT(processCues()));
+    connect(m_switcherClock, SIGNAL(updated()),
+            this, SLOT(processCues()));
+}
+
+bool QAtemScheduler::isLocked() const
+{
+    return m_switcherClock->isValid();
+}
+
+quint32 QAtemScheduler::currentTimecode() const
+{
+    return m_switcherClock->currentTimecode();
+}
+
+int QAtemScheduler::schedule(quint32 timecode, QObject *receiver, const char *member)
+{
+    QByteArray name(member);
+
+    // QMetaObject::invokeMethod() wants the plain name, strip the code and signature SLOT() adds
+    if(!name.isEmpty() && name.at(0) >= '0' && name.at(0) <= '9')
+    {
+        name.remove(0, 1);
+    }
+
+    int signature = name.indexOf('(');
+
+    if(signature >= 0)
+    {
+        name.truncate(signature);
+    }
+
+    if(!receiver || name.isEmpty())
+    {
+        return -1;
+    }
+
+    Cue cue;
+    cue.id = m_nextId++;
+    cue.timecode = timecode;
+    cue.receiver = receiver;
+    cue.member = name;
+
+    m_cues.append(cue);
+    processCues();
+
+    return cue.id;
+}
+
+int QAtemScheduler::schedule(quint32 timecode, QAtemTransaction *transaction)
+{
+    if(!transaction || transaction->state() != QAtemTransaction::Open)
+    {
+        return -1;
+    }
+
+    transaction->detach();
+
+    Cue cue;
+    cue.id = m_nextId++;
+    cue.timecode = timecode;
+    cue.transaction = transaction;
+
+    m_cues.append(cue);
+    processCues();
+
+    return cue.id;
+}
+
+void QAtemScheduler::cancel(int id)
+{
+    for(int i = 0; i < m_cues.size(); ++i)
+    {
+        if(m_cues.at(i).id == id)
+        {
+            Cue cue = m_cues.takeAt(i);
+
+            if(cue.transaction)
+            {
+                cue.transaction->cancel();
+            }
+
+            break;
+        }
+    }
+
+    processCues();
+}
+
+void QAtemScheduler::clear()
+{
+    QList<Cue> cues = m_cues;
+    m_cues.clear();
+    m_timer.stop();
+
+    foreach(const Cue &cue, cues)
+    {
+        if(cue.transaction)
+        {
+            cue.transaction->cancel();
+        }
+    }
+}
+
+void QAtemScheduler::processCues()
+{
+    if(!m_switcherClock->isValid() || m_cues.isEmpty() || !m_connection)
+    {
+        m_timer.stop();
+        return;
+    }
+
+    float rtt = m_connection->roundTripTime();
+    double latency = (rtt > 0 ? rtt / 2.0 : 0.0) + m_leadTime;
+    double now = m_switcherClock->now();
+    QList<Cue> due;
+    QList<bool> late;
+
+    for(int i = 0; i < m_cues.size();)
+    {
+        double deadline = m_switcherClock->localTimeOfFrame(m_switcherClock->timecodeFrame(m_cues.at(i).timecode)) - latency;
+
+        if(deadline <= now)
+        {
+            // Keep due cues in frame order
+            int pos = 0;
+
+            while(pos < due.size() && m_switcherClock->msecsUntilFrame(m_switcherClock->timecodeFrame(due.at(pos).timecode)) <=
+                  m_switcherClock->msecsUntilFrame(m_switcherClock->timecodeFrame(m_cues.at(i).timecode)))
+            {
+                ++pos;
+            }
+
+            late.insert(pos, (now - deadline) > m_leadTime);
+            due.insert(pos, m_cues.takeAt(i));
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    if(!due.isEmpty())
+    {
+        // Cues due together go out in their own transaction, one the caller has open would hold them back
+        QPointer<QAtemTransaction> callerTransaction = m_connection->currentTransaction();
+
+        if(callerTransaction)
+        {
+            callerTransaction->detach();
+        }
+
+        QPointer<QAtemTransaction> transaction = m_connection->beginTransaction();
+        QList<bool> failed;
+
+        for(int i = 0; i < due.size(); ++i)
+        {
+            const Cue &cue = due.at(i);
+
+            if(cue.member.isEmpty())
+            {
+                failed.append(!cue.transaction || cue.transaction->state() != QAtemTransaction::Open);
+            }
+            else
+            {
+                failed.append(!cue.receiver ||
+                              !QMetaObject::invokeMethod(cue.receiver, cue.member.constData(), Qt::DirectConnection));
+            }
+        }
+
+        // The scheduled transactions share the datagrams of the frame, after the commands of the called members
+        QList<QAtemTransaction*> transactions;
+        transactions.append(transaction);
+
+        for(int i = 0; i < due.size(); ++i)
+        {
+            if(!failed.at(i) && due.at(i).transaction)
+            {
+                transactions.append(due.at(i).transaction);
+            }
+        }
+
+        QAtemTransaction::commitTogether(transactions);
+
+        if(callerTransaction)
+        {
+            callerTransaction->attach();
+        }
+
+        for(int i = 0; i < due.size(); ++i)
+        {
+            if(failed.at(i))
+            {
+                emit cueFailed(due.at(i).id);
+                continue;
+            }
+
+            emit cueExecuted(due.at(i).id, late.at(i));
+        }
+
+        if(!m_connection)
+        {
+            return;
+        }
+
+        now = m_switcherClock->now();
+    }
+
+    if(m_cues.isEmpty() || !m_switcherClock->isValid())
+    {
+        m_timer.stop();
+        return;
+    }
+
+    double next = -1;
+
+    foreach(const Cue &cue, m_cues)
+    {
+        double deadline = m_switcherClock->localTimeOfFrame(m_switcherClock->timecodeFrame(cue.timecode)) - latency;
+        next = next < 0 ? deadline : qMin(next, deadline);
+    }
+
+    m_timer.start(qMax(0, static_cast<int>(ceil(next - now))));
+}
@@ -0,0 +1,107 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QATEMSCHEDULER_H
+#define QATEMSCHEDULER_H
+
+#include "libqatemcontrol_global.h"
+
+#include <QObject>
+#include <QPointer>
+#include <QList>
+#include <QTimer>
+
+class QAtemConnection;
+class QAtemTransaction;
+class QAtemSwitcherClock;
+
+/**
+ * Runs cues at specific frames of the switcher's timecode. The scheduler follows the switcher's frame clock with a
+ * QAtemSwitcherClock and sends each cue just ahead of its frame, compensating for the measured round trip time so
+ * the commands arrive in the frame before the target frame.
+ *
+ * Timecodes are packed like QAtemConnection::timeChanged(), see QAtemSwitcherClock.
+ */
+class LIBQATEMCONTROLSHARED_EXPORT QAtemScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QAtemScheduler(QAtemConnection *connection, QObject *parent = nullptr);
+
+    /// @returns true if the scheduler is locked to the switcher's frame clock
+    bool isLocked() const;
+    /// @returns the estimated timecode of the frame the switcher is outputting now
+    quint32 currentTimecode() const;
+    /// @returns the clock the cues are timed with
+    QAtemSwitcherClock *clock() const { return m_switcherClock; }
+
+    /// Send cues @p msecs earlier than the one way latency requires, to absorb network jitter. Default is 5.
+    void setLeadTime(int msecs) { m_leadTime = msecs; }
+    int leadTime() const { return m_leadTime; }
+
+    /**
+     * Call @p member of @p receiver when the switcher is about to output the frame @p timecode. @p member is the name
+     * of a slot or invokable method without arguments, SLOT(foo()) is accepted too. Cues due at the same time run in
+     * one transaction so their commands are sent together, a transaction the caller has open isn't used for them.
+     * @returns the ID of the cue or -1 if @p receiver or @p member is missing
+     */
+    int schedule(quint32 timecode, QObject *receiver, const char *member);
+    /**
+     * Commit @p transaction when the switcher is about to output the frame @p timecode. The transaction is detached
+     * from the connection, setters called afterwards are not added to it. Its commands are sent together with the
+     * ones of the other cues due at the same time.
+     * @returns the ID of the cue
+     */
+    int schedule(quint32 timecode, QAtemTransaction *transaction);
+    /// Remove the cue with ID @p id, a transaction it would have committed is cancelled
+    void cancel(int id);
+    /// Remove all cues
+    void clear();
+    /// @returns the number of cues waiting to run
+    int pendingCount() const { return m_cues.size(); }
+
+protected slots:
+    /// Run the cues that are due and schedule the timer for the next one
+    void processCues();
+
+private:
+    struct Cue
+    {
+        int id;
+        quint32 timecode;
+        QPointer<QObject> receiver;
+        QByteArray member;
+        QPointer<QAtemTransaction> transaction;
+    };
+
+    QPointer<QAtemConnection> m_connection;
+    QList<Cue> m_cues;
+    int m_nextId;
+    int m_leadTime;
+
+    QAtemSwitcherClock *m_switcherClock;
+    QTimer m_timer;
+
+signals:
+    void lockedChanged(bool locked);
+    /// Emitted when the cue @p id has run, @p late is true if it was sent after its deadline
+    void cueExecuted(int id, bool late);
+    /// Emitted when the cue @p id couldn't run, its receiver was deleted or has no method named like its member
+    void cueFailed(int id);
+};
+
+#endif // QATEMSCHEDULER_H
@@ -0,0 +1,236 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "qatemsounduploader.h"
+#include "qatemconnection.h"
+#include "qatemwavreader.h"
+
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QTimer>
+#include <QtConcurrentRun>
+
+static QByteArray hashWavFile(const QString &fileName)
+{
+    QAtemWavReader reader(fileName);
+
+    if(!reader.open(QIODevice::ReadOnly))
+    {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    QByteArray block(QAtemWavReader::OutputFrameSize * 16384, Qt::Uninitialized);
+    qint64 remaining = reader.size();
+
+    while(remaining > 0)
+    {
+        qint64 size = reader.read(block.data(), block.size());
+
+        if(size <= 0)
+        {
+            return QByteArray();
+        }
+
+        hash.addData(block.constData(), static_cast<int>(size));
+        remaining -= size;
+    }
+
+    return hash.result();
+}
+
+QAtemSoundUploader::QAtemSoundUploader(QAtemConnection *connection, QObject *parent) :
+    QObject(parent), m_connection(connection)
+{
+    m_state = Idle;
+    m_index = 0;
+    m_reader = nullptr;
+    m_transferId = 0;
+    m_locked = false;
+
+    connect(&m_hashWatcher, SIGNAL(finished()),
+            this, SLOT(handleHashingFinished()));
+    connect(m_connection, SIGNAL(getLockStateChanged(quint8,bool)),
+            this, SLOT(handleGetLockStateChanged(quint8,bool)));
+    connect(m_connection, SIGNAL(mediaLockStateChanged(quint8,bool)),
+            this, SLOT(handleMediaLockStateChanged(quint8,bool)));
+    connect(m_connection, SIGNAL(dataTransferFinished(quint16)),
+            this, SLOT(handleDataTransferFinished(quint16)));
+    connect(m_connection, SIGNAL(dataTransferFailed(quint16)),
+            this, SLOT(handleDataTransferFailed(quint16)));
+    connect(m_connection, SIGNAL(disconnected()),
+            this, SLOT(handleDisconnected()));
+    connect(m_connection, SIGNAL(connected()),
+            this, SLOT(handleConnected()));
+}
+
+QAtemSoundUploader::~QAtemSoundUploader()
+{
+    m_hashWatcher.waitForFinished();
+}
+
+bool QAtemSoundUploader::upload(quint8 index, const QString &fileName, const QString &name)
+{
+    if(m_state != Idle || index > 1)
+    {
+        return false;
+    }
+
+    delete m_reader;
+    m_reader = new QAtemWavReader(fileName, this);
+
+    if(!m_reader->open(QIODevice::ReadOnly))
+    {
+        emit uploadError(m_reader->errorString());
+        delete m_reader;
+        m_reader = nullptr;
+        return false;
+    }
+
+    m_index = index;
+    m_name = name.isEmpty() ? QFileInfo(fileName).baseName().toUtf8() : name.toUtf8();
+    m_transferId = 0;
+    m_state = Hashing;
+
+    m_hashWatcher.setFuture(QtConcurrent::run(hashWavFile, fileName));
+
+    return true;
+}
+
+void QAtemSoundUploader::handleHashingFinished()
+{
+    if(m_state != Hashing)
+    {
+        return;
+    }
+
+    if(m_hashWatcher.result().isEmpty())
+    {
+        emit uploadError(tr("Failed to read audio data"));
+        finish(false);
+        return;
+    }
+
+    m_state = AquiringLock;
+
+    if(!m_connection->mediaLockState(QAtemConnection::clipStoreId(m_index)))
+    {
+        m_connection->aquireMediaLock(QAtemConnection::clipStoreId(m_index), 0);
+    }
+}
+
+void QAtemSoundUploader::handleGetLockStateChanged(quint8 storeId, bool state)
+{
+    if(storeId != QAtemConnection::clipStoreId(m_index) || m_state != AquiringLock || !state)
+    {
+        return;
+    }
+
+    m_locked = true;
+    m_state = Uploading;
+    startTransfer();
+}
+
+void QAtemSoundUploader::handleMediaLockStateChanged(quint8 id, bool state)
+{
+    // Released by someone else, try again
+    if(id == QAtemConnection::clipStoreId(m_index) && !state && m_state == AquiringLock)
+    {
+        m_connection->aquireMediaLock(QAtemConnection::clipStoreId(m_index), 0);
+    }
+}
+
+void QAtemSoundUploader::startTransfer()
+{
+    if(m_state != Uploading || m_transferId != 0)
+    {
+        return;
+    }
+
+    // Only one transfer can run at a time
+    if(m_connection->transferActive())
+    {
+        QTimer::singleShot(100, this, SLOT(startTransfer()));
+        return;
+    }
+
+    m_reader->seek(0);
+    m_transferId = m_connection->sendClipAudioToSwitcher(m_index, m_name, m_reader, m_reader->size(), m_hashWatcher.result());
+
+    if(m_transferId == 0)
+    {
+        QTimer::singleShot(100, this, SLOT(startTransfer()));
+    }
+}
+
+void QAtemSoundUploader::handleDataTransferFinished(quint16 transferId)
+{
+    if(m_state == Uploading && transferId == m_transferId)
+    {
+        finish(true);
+    }
+}
+
+void QAtemSoundUploader::handleDataTransferFailed(quint16 transferId)
+{
+    if(m_state == Uploading && transferId == m_transferId)
+    {
+        emit uploadError(tr("The transfer failed"));
+        finish(false);
+    }
+}
+
+void QAtemSoundUploader::handleDisconnected()
+{
+    // Once the transfer has started the connection restarts it after a reconnect, before that the lock request
+    // was lost with the session
+    if(m_state == AquiringLock || (m_state == Uploading && m_transferId == 0))
+    {
+        m_locked = false;
+        m_state = AquiringLock;
+    }
+}
+
+void QAtemSoundUploader::handleConnected()
+{
+    if(m_state == AquiringLock && !m_connection->mediaLockState(QAtemConnection::clipStoreId(m_index)))
+    {
+        m_connection->aquireMediaLock(QAtemConnection::clipStoreId(m_index), 0);
+    }
+}
+
+void QAtemSoundUploader::finish(bool success)
+{
+    // Also release a lock that was requested but not granted yet, unless the session holding it is gone
+    if((m_locked || m_state == AquiringLock) && m_connection->isConnected())
+    {
+        m_connection->unlockMediaLock(QAtemConnection::clipStoreId(m_index));
+    }
+
+    m_locked = false;
+    m_state = Idle;
+    m_transferId = 0;
+
+    if(m_reader)
+    {
+        m_reader->close();
+        m_reader->deleteLater();
+        m_reader = nullptr;
+    }
+
+    emit uploadFinished(success);
+}
@@ -0,0 +1,87 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QATEMSOUNDUPLOADER_H
+#define QATEMSOUNDUPLOADER_H
+
+#include "libqatemcontrol_global.h"
+
+#include <QObject>
+#include <QFutureWatcher>
+
+class QAtemConnection;
+class QAtemWavReader;
+
+/**
+ * Uploads WAV files as the audio of a media pool clip. The audio is kept in the store of the clip, next to its frames.
+ * The file is streamed twice in blocks, once on the global QThreadPool to calculate the MD5 and once through the
+ * transfer engine while it's uploaded, so only a few blocks of audio are in memory at any time.
+ */
+class LIBQATEMCONTROLSHARED_EXPORT QAtemSoundUploader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QAtemSoundUploader(QAtemConnection *connection, QObject *parent = nullptr);
+    ~QAtemSoundUploader();
+
+    /**
+     * Upload the WAV file @p fileName as the audio of media pool clip @p index (0 or 1), named @p name or after the
+     * file if @p name is empty.
+     * @returns false if an upload is already running, @p index isn't a clip or the file can't be read
+     */
+    bool upload(quint8 index, const QString &fileName, const QString &name = QString());
+
+    bool isRunning() const { return m_state != Idle; }
+
+protected slots:
+    void handleHashingFinished();
+    void handleGetLockStateChanged(quint8 storeId, bool state);
+    void handleMediaLockStateChanged(quint8 id, bool state);
+    void handleDataTransferFinished(quint16 transferId);
+    void handleDataTransferFailed(quint16 transferId);
+    void handleDisconnected();
+    void handleConnected();
+
+    void startTransfer();
+
+private:
+    enum State
+    {
+        Idle,
+        Hashing,
+        AquiringLock,
+        Uploading
+    };
+
+    void finish(bool success);
+
+    QAtemConnection *m_connection;
+    State m_state;
+
+    quint8 m_index;
+    QByteArray m_name;
+    QAtemWavReader *m_reader;
+    QFutureWatcher<QByteArray> m_hashWatcher;
+    quint16 m_transferId;
+    bool m_locked;
+
+signals:
+    void uploadFinished(bool success);
+    void uploadError(const QString &errorString);
+};
+
+#endif // QATEMSOUNDUPLOADER_H
@@ -0,0 +1,263 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "qatemswitcherclock.h"
+#include "qatemconnection.h"
+
+#include <math.h>
+
+/// Weight kept by the older samples for every new one, about the last hundred samples make up the fit
+static const double sampleDecay = 0.99;
+/// Frame durations further than this from the nominal one are measurement noise, not drift
+static const double maxFrameDurationError = 0.001;
+/// A sample this many frames off the fit means the timecode jumped, the fit starts over
+static const double resyncFrames = 3.0;
+/// Number of late samples in a row that are left out of the fit before they are trusted
+static const int maxRejected = 8;
+
+QAtemSwitcherClock::QAtemSwitcherClock(QAtemConnection *connection, QObject *parent) :
+    QObject(parent), m_connection(connection)
+{
+    m_valid = false;
+    m_frameRate = 0;
+    m_clock.start();
+
+    reset();
+
+    if(m_connection)
+    {
+        connect(m_connection, SIGNAL(timeChanged(quint32)),
+                this, SLOT(handleTime(quint32)));
+        connect(m_connection, SIGNAL(videoFormatChanged(quint8)),
+                this, SLOT(handleVideoFormat()));
+        connect(m_connection, SIGNAL(disconnected()),
+                this, SLOT(reset()));
+    }
+}
+
+int QAtemSwitcherClock::nominalFrameRate() const
+{
+    return qRound(m_frameRate);
+}
+
+quint32 QAtemSwitcherClock::framesPerDay() const
+{
+    return 24 * 3600 * static_cast<quint32>(qMax(1, nominalFrameRate()));
+}
+
+double QAtemSwitcherClock::now() const
+{
+    return m_clock.nsecsElapsed() / 1000000.0;
+}
+
+double QAtemSwitcherClock::currentFrame() const
+{
+    if(!m_valid)
+    {
+        return 0;
+    }
+
+    double frames = m_originFrame + ((now() - m_originTime - m_offset) / m_msecsPerFrame);
+    double day = framesPerDay();
+
+    frames = fmod(frames, day);
+
+    return frames < 0 ? frames + day : frames;
+}
+
+quint32 QAtemSwitcherClock::currentTimecode() const
+{
+    if(!m_valid)
+    {
+        return 0;
+    }
+
+    return framesToTimecode(static_cast<quint32>(currentFrame()), nominalFrameRate());
+}
+
+double QAtemSwitcherClock::localTimeOfFrame(quint32 frame) const
+{
+    return m_originTime + m_offset + (framesFromOrigin(frame) * m_msecsPerFrame);
+}
+
+quint32 QAtemSwitcherClock::timecodeFrame(quint32 timecode) const
+{
+    return timecodeToFrames(timecode, nominalFrameRate()) % framesPerDay();
+}
+
+double QAtemSwitcherClock::drift() const
+{
+    if(m_frameRate <= 0)
+    {
+        return 0;
+    }
+
+    return ((m_msecsPerFrame * m_frameRate / 1000.0) - 1.0) * 1000000.0;
+}
+
+void QAtemSwitcherClock::reset()
+{
+    m_originFrame = 0;
+    m_originTime = 0;
+    m_offset = 0;
+    m_msecsPerFrame = m_frameRate > 0 ? 1000.0 / m_frameRate : 0;
+    m_sumW = 0;
+    m_sumX = 0;
+    m_sumY = 0;
+    m_sumXX = 0;
+    m_sumXY = 0;
+    m_jitter = 0;
+    m_samples = 0;
+    m_rejected = 0;
+
+    setValid(false);
+}
+
+quint32 QAtemSwitcherClock::timecodeToFrames(quint32 timecode, int framesPerSecond)
+{
+    quint32 hours = (timecode >> 24) & 0xff;
+    quint32 minutes = (timecode >> 16) & 0xff;
+    quint32 seconds = (timecode >> 8) & 0xff;
+    quint32 frames = timecode & 0xff;
+
+    return (((hours * 60) + minutes) * 60 + seconds) * static_cast<quint32>(framesPerSecond) + frames;
+}
+
+quint32 QAtemSwitcherClock::framesToTimecode(quint32 frames, int framesPerSecond)
+{
+    if(framesPerSecond <= 0)
+    {
+        return 0;
+    }
+
+    quint32 fps = static_cast<quint32>(framesPerSecond);
+    quint32 seconds = frames / fps;
+
+    return ((seconds / 3600) % 24) << 24 | ((seconds / 60) % 60) << 16 | (seconds % 60) << 8 | (frames % fps);
+}
+
+void QAtemSwitcherClock::handleTime(quint32 time)
+{
+    if(!m_connection)
+    {
+        return;
+    }
+
+    float frameRate = m_connection->currentVideoMode().framesPerSecond;
+
+    if(frameRate <= 0)
+    {
+        return;
+    }
+
+    if(!qFuzzyCompare(frameRate, m_frameRate))
+    {
+        m_frameRate = frameRate;
+        reset();
+    }
+
+    // The update left the switcher half a round trip ago
+    float rtt = m_connection->roundTripTime();
+    addSample(timecodeFrame(time), now() - (rtt > 0 ? rtt / 2.0 : 0.0));
+}
+
+void QAtemSwitcherClock::handleVideoFormat()
+{
+    // The timecode has to be picked up again at the new frame rate
+    m_frameRate = 0;
+    reset();
+}
+
+void QAtemSwitcherClock::addSample(quint32 frame, double time)
+{
+    double nominal = 1000.0 / m_frameRate;
+
+    if(m_samples > 0)
+    {
+        qint64 frames = framesFromOrigin(frame);
+        double residual = time - (m_originTime + m_offset + (frames * m_msecsPerFrame));
+
+        if(fabs(residual) > resyncFrames * nominal)
+        {
+            reset();
+        }
+        else if(m_samples > 4 && residual > qMax(3.0 * m_jitter, 1.0) && m_rejected < maxRejected)
+        {
+            // Updates only arrive late, not early, a late one says more about the network than the clock
+            ++m_rejected;
+            return;
+        }
+        else
+        {
+            m_rejected = 0;
+            m_jitter = (m_jitter * 0.9) + (fabs(residual) * 0.1);
+
+            // Move the origin of the fit to this sample to keep the sums small
+            double dx = frames;
+            double dy = time - m_originTime;
+
+            m_sumXY = m_sumXY - (dx * m_sumY) - (dy * m_sumX) + (dx * dy * m_sumW);
+            m_sumXX = m_sumXX - (2.0 * dx * m_sumX) + (dx * dx * m_sumW);
+            m_sumX -= dx * m_sumW;
+            m_sumY -= dy * m_sumW;
+        }
+    }
+
+    m_originFrame = frame;
+    m_originTime = time;
+
+    m_sumW = (m_sumW * sampleDecay) + 1.0;
+    m_sumX *= sampleDecay;
+    m_sumY *= sampleDecay;
+    m_sumXX *= sampleDecay;
+    m_sumXY *= sampleDecay;
+    ++m_samples;
+
+    double slope = nominal;
+    double denominator = (m_sumW * m_sumXX) - (m_sumX * m_sumX);
+
+    if(m_samples > 2 && denominator > 1e-9)
+    {
+        slope = ((m_sumW * m_sumXY) - (m_sumX * m_sumY)) / denominator;
+        slope = qBound(nominal * (1.0 - maxFrameDurationError), slope, nominal * (1.0 + maxFrameDurationError));
+    }
+
+    m_msecsPerFrame = slope;
+    m_offset = (m_sumY - (slope * m_sumX)) / m_sumW;
+
+    setValid(true);
+    emit updated();
+}
+
+qint64 QAtemSwitcherClock::framesFromOrigin(quint32 frame) const
+{
+    qint64 day = framesPerDay();
+    qint64 distance = ((static_cast<qint64>(frame) - m_originFrame) % day + day) % day;
+
+    return distance > day / 2 ? distance - day : distance;
+}
+
+void QAtemSwitcherClock::setValid(bool valid)
+{
+    if(valid == m_valid)
+    {
+        return;
+    }
+
+    m_valid = valid;
+    emit validChanged(m_valid);
+}
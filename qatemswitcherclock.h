@@ -0,0 +1,126 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QATEMSWITCHERCLOCK_H
+#define QATEMSWITCHERCLOCK_H
+
+#include "libqatemcontrol_global.h"
+
+#include <QObject>
+#include <QPointer>
+#include <QElapsedTimer>
+
+class QAtemConnection;
+
+/**
+ * Model of the switcher's frame clock. Every Time update from the switcher, corrected for half the round trip
+ * time, is a sample of when a frame started on the local monotonic clock. The samples are fitted to a line with
+ * an exponentially weighted least squares fit, which gives the measured frame duration, and from that the drift
+ * against the local clock, and the start of any frame. Updates delayed far more than the usual jitter are left out
+ * of the fit. All queries are constant time.
+ *
+ * Timecodes are packed like QAtemConnection::timeChanged(), hours, minutes, seconds and frames from the most to the
+ * least significant byte. Frame numbers count the frames since midnight at the nominal frame rate of the video
+ * mode, non drop frame.
+ */
+class LIBQATEMCONTROLSHARED_EXPORT QAtemSwitcherClock : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QAtemSwitcherClock(QAtemConnection *connection, QObject *parent = nullptr);
+
+    /// @returns true if the clock has been synchronized with the switcher
+    bool isValid() const { return m_valid; }
+    /// @returns the frame rate of the current video mode
+    float frameRate() const { return m_frameRate; }
+    /// @returns the frame rate used to count timecode frames, the frame rate rounded to the nearest integer
+    int nominalFrameRate() const;
+    /// @returns the number of frames in a day at the nominal frame rate
+    quint32 framesPerDay() const;
+
+    /// @returns the local monotonic time in milliseconds, the time base of localTimeOfFrame()
+    double now() const;
+    /// @returns the frame the switcher is outputting now, the fraction is how far into the frame it is
+    double currentFrame() const;
+    /// @returns the timecode of the frame the switcher is outputting now
+    quint32 currentTimecode() const;
+    /// @returns the local time in milliseconds, see now(), the switcher starts outputting @p frame
+    double localTimeOfFrame(quint32 frame) const;
+    /// @returns the milliseconds until the switcher starts outputting @p frame, negative if it has started
+    double msecsUntilFrame(quint32 frame) const { return localTimeOfFrame(frame) - now(); }
+    /// @returns the frame number of @p timecode
+    quint32 timecodeFrame(quint32 timecode) const;
+
+    /// @returns the measured duration of a frame in milliseconds of the local clock
+    double frameDuration() const { return m_msecsPerFrame; }
+    /// @returns how much faster, in parts per million, the local clock runs than the switcher's
+    double drift() const;
+    /// @returns the average deviation in milliseconds of the time updates from the fit
+    double jitter() const { return m_jitter; }
+    /// @returns the number of time updates used since the clock was synchronized
+    int sampleCount() const { return m_samples; }
+
+    /// @returns the number of frames since midnight at @p timecode, with @p framesPerSecond frames per second
+    static quint32 timecodeToFrames(quint32 timecode, int framesPerSecond);
+    /// @returns the timecode of frame @p frames since midnight, with @p framesPerSecond frames per second
+    static quint32 framesToTimecode(quint32 frames, int framesPerSecond);
+
+public slots:
+    /// Forget the fit, the clock is synchronized again from the next time update
+    void reset();
+
+protected slots:
+    void handleTime(quint32 time);
+    void handleVideoFormat();
+
+protected:
+    /// Add a sample of @p frame starting at local time @p time to the fit
+    void addSample(quint32 frame, double time);
+    /// @returns the number of frames from the fit origin to @p frame, taking midnight into account
+    qint64 framesFromOrigin(quint32 frame) const;
+    void setValid(bool valid);
+
+private:
+    QPointer<QAtemConnection> m_connection;
+    QElapsedTimer m_clock;
+    bool m_valid;
+    float m_frameRate;
+
+    // The fit is kept relative to the last sample, time = m_originTime + m_offset + frames * m_msecsPerFrame
+    quint32 m_originFrame;
+    double m_originTime;
+    double m_offset;
+    double m_msecsPerFrame;
+
+    // Exponentially weighted sums of the least squares fit
+    double m_sumW;
+    double m_sumX;
+    double m_sumY;
+    double m_sumXX;
+    double m_sumXY;
+
+    double m_jitter;
+    int m_samples;
+    int m_rejected;
+
+signals:
+    void validChanged(bool valid);
+    /// Emitted when a time update has been added to the fit
+    void updated();
+};
+
+#endif // QATEMSWITCHERCLOCK_H
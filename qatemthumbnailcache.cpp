@@ -0,0 +1,268 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "qatemthumbnailcache.h"
+#include "qatemconnection.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QTimer>
+
+QAtemThumbnailCache::QAtemThumbnailCache(QAtemConnection *connection, QObject *parent) :
+    QObject(parent), m_connection(connection)
+{
+    m_cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails";
+    m_thumbnailSize = QSize(160, 90);
+    m_fetchState = Idle;
+    m_locked = false;
+    m_fetchIndex = 0;
+    m_transferId = 0;
+
+    connect(m_connection, SIGNAL(mediaInfoChanged(QAtem::MediaInfo)),
+            this, SLOT(handleMediaInfoChanged(QAtem::MediaInfo)));
+    connect(m_connection, SIGNAL(getLockStateChanged(quint8,bool)),
+            this, SLOT(handleGetLockStateChanged(quint8,bool)));
+    connect(m_connection, SIGNAL(mediaLockStateChanged(quint8,bool)),
+            this, SLOT(handleMediaLockStateChanged(quint8,bool)));
+    connect(m_connection, SIGNAL(dataTransferFinished(quint16)),
+            this, SLOT(handleDataTransferFinished(quint16)));
+    connect(m_connection, SIGNAL(disconnected()),
+            this, SLOT(handleDisconnected()));
+
+    refresh();
+}
+
+void QAtemThumbnailCache::setCacheDirectory(const QString &path)
+{
+    if(path == m_cacheDirectory)
+    {
+        return;
+    }
+
+    m_cacheDirectory = path;
+    m_hashes.clear();
+    refresh();
+}
+
+void QAtemThumbnailCache::setThumbnailSize(const QSize &size)
+{
+    if(size == m_thumbnailSize || size.isEmpty())
+    {
+        return;
+    }
+
+    m_thumbnailSize = size;
+    m_hashes.clear();
+    refresh();
+}
+
+void QAtemThumbnailCache::refresh()
+{
+    for(quint8 i = 0; i < m_connection->mediaPoolStillBankCount(); ++i)
+    {
+        updateStill(m_connection->stillMediaInfo(i));
+    }
+}
+
+void QAtemThumbnailCache::handleMediaInfoChanged(const QAtem::MediaInfo &info)
+{
+    if(info.type == QAtem::StillMedia)
+    {
+        updateStill(info);
+    }
+}
+
+void QAtemThumbnailCache::updateStill(const QAtem::MediaInfo &info)
+{
+    // The switcher repeats the media pool state, only act on new content
+    if(m_hashes.contains(info.index) && m_hashes.value(info.index) == info.hash)
+    {
+        return;
+    }
+
+    m_hashes.insert(info.index, info.hash);
+
+    if(!info.used)
+    {
+        m_pending.removeAll(info.index);
+        setThumbnail(info.index, QImage());
+        return;
+    }
+
+    QImage cached(cacheFileName(info.hash));
+
+    if(!cached.isNull())
+    {
+        m_pending.removeAll(info.index);
+        setThumbnail(info.index, cached);
+        return;
+    }
+
+    if(!m_pending.contains(info.index))
+    {
+        m_pending.append(info.index);
+    }
+
+    fetchNext();
+}
+
+void QAtemThumbnailCache::fetchNext()
+{
+    if(m_fetchState != Idle)
+    {
+        return;
+    }
+
+    if(m_pending.isEmpty())
+    {
+        releaseLock();
+        return;
+    }
+
+    if(!m_locked)
+    {
+        m_fetchState = AquiringLock;
+        m_connection->aquireLock(0);
+        return;
+    }
+
+    // Only one transfer can run at a time, try again when the current one is done
+    if(m_connection->transferActive())
+    {
+        QTimer::singleShot(100, this, SLOT(fetchNext()));
+        return;
+    }
+
+    m_fetchIndex = m_pending.takeFirst();
+    m_fetchHash = m_hashes.value(m_fetchIndex);
+    m_transferId = m_connection->getDataFromSwitcher(0, m_fetchIndex);
+    m_fetchState = m_transferId ? Downloading : Idle;
+
+    if(m_fetchState == Idle)
+    {
+        m_pending.prepend(m_fetchIndex);
+        QTimer::singleShot(100, this, SLOT(fetchNext()));
+    }
+}
+
+void QAtemThumbnailCache::handleGetLockStateChanged(quint8 storeId, bool state)
+{
+    if(storeId != 0 || m_fetchState != AquiringLock)
+    {
+        return;
+    }
+
+    m_locked = state;
+    m_fetchState = Idle;
+
+    if(m_locked)
+    {
+        fetchNext();
+    }
+}
+
+void QAtemThumbnailCache::handleMediaLockStateChanged(quint8 id, bool state)
+{
+    // Someone else released the lock while we were waiting for it
+    if(id == 0 && !state && m_fetchState == AquiringLock)
+    {
+        m_connection->aquireLock(0);
+    }
+}
+
+void QAtemThumbnailCache::handleDataTransferFinished(quint16 transferId)
+{
+    if(m_fetchState != Downloading || transferId != m_transferId)
+    {
+        return;
+    }
+
+    m_fetchState = Idle;
+
+    QSize size = m_connection->currentVideoMode().size;
+    QImage image = QAtemConnection::imageFromSwitcher(m_connection->transferData(), size.width(), size.height(), m_connection->colorMatrix());
+
+    if(image.isNull())
+    {
+        qWarning() << "Failed to decode still" << m_fetchIndex;
+    }
+    else
+    {
+        QImage thumbnail = image.scaled(m_thumbnailSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+        if(!QDir().mkpath(m_cacheDirectory) || !thumbnail.save(cacheFileName(m_fetchHash), "PNG"))
+        {
+            qWarning() << "Failed to cache thumbnail for still" << m_fetchIndex << "in" << m_cacheDirectory;
+        }
+
+        // The still may have changed while it was downloaded, it's queued again in that case
+        if(m_hashes.value(m_fetchIndex) == m_fetchHash)
+        {
+            setThumbnail(m_fetchIndex, thumbnail);
+        }
+    }
+
+    fetchNext();
+}
+
+void QAtemThumbnailCache::handleDisconnected()
+{
+    m_fetchState = Idle;
+    m_locked = false;
+    m_pending.clear();
+    m_hashes.clear();
+
+    // The stills may change while disconnected, the files on disk are kept and reused when the hashes match again
+    foreach(quint8 index, m_thumbnails.keys())
+    {
+        setThumbnail(index, QImage());
+    }
+}
+
+QString QAtemThumbnailCache::cacheFileName(const QByteArray &hash) const
+{
+    return QString("%1/%2_%3x%4.png").arg(m_cacheDirectory, QString::fromLatin1(hash.toHex()))
+            .arg(m_thumbnailSize.width()).arg(m_thumbnailSize.height());
+}
+
+void QAtemThumbnailCache::setThumbnail(quint8 index, const QImage &thumbnail)
+{
+    if(thumbnail.isNull())
+    {
+        if(m_thumbnails.remove(index) == 0)
+        {
+            return;
+        }
+    }
+    else
+    {
+        m_thumbnails.insert(index, thumbnail);
+    }
+
+    emit thumbnailChanged(index, thumbnail);
+}
+
+void QAtemThumbnailCache::releaseLock()
+{
+    if(m_locked)
+    {
+        m_connection->unlockMediaLock(0);
+        m_locked = false;
+    }
+}
@@ -0,0 +1,100 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QATEMTHUMBNAILCACHE_H
+#define QATEMTHUMBNAILCACHE_H
+
+#include "libqatemcontrol_global.h"
+#include "qatemtypes.h"
+
+#include <QObject>
+#include <QHash>
+#include <QImage>
+#include <QList>
+
+class QAtemConnection;
+
+/**
+ * Keeps thumbnails of the stills in the media pool.
+ * Stills are downloaded, decoded and scaled down when their hash changes. Thumbnails are cached on disk
+ * under the still's hash so a still is only downloaded again when its content changes.
+ */
+class LIBQATEMCONTROLSHARED_EXPORT QAtemThumbnailCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QAtemThumbnailCache(QAtemConnection *connection, QObject *parent = nullptr);
+
+    /// Directory thumbnails are cached in, defaults to "thumbnails" in the application's cache location.
+    void setCacheDirectory(const QString &path);
+    QString cacheDirectory() const { return m_cacheDirectory; }
+
+    /// Largest size of the thumbnails, the aspect ratio of the stills is kept. Defaults to 160x90.
+    void setThumbnailSize(const QSize &size);
+    QSize thumbnailSize() const { return m_thumbnailSize; }
+
+    /// @returns the thumbnail for still @p index, a null image if the still is unused, not fetched yet or disconnected.
+    QImage thumbnail(quint8 index) const { return m_thumbnails.value(index); }
+    /// @returns true while stills are waiting to be downloaded
+    bool isFetching() const { return m_fetchState != Idle || !m_pending.isEmpty(); }
+
+public slots:
+    /// Check all stills in the media pool, only stills without a thumbnail for their current hash are downloaded.
+    void refresh();
+
+protected slots:
+    void handleMediaInfoChanged(const QAtem::MediaInfo &info);
+    void handleGetLockStateChanged(quint8 storeId, bool state);
+    void handleMediaLockStateChanged(quint8 id, bool state);
+    void handleDataTransferFinished(quint16 transferId);
+    void handleDisconnected();
+
+    void fetchNext();
+
+private:
+    enum FetchState
+    {
+        Idle,
+        AquiringLock,
+        Downloading
+    };
+
+    void updateStill(const QAtem::MediaInfo &info);
+    QString cacheFileName(const QByteArray &hash) const;
+    void setThumbnail(quint8 index, const QImage &thumbnail);
+    void releaseLock();
+
+    QAtemConnection *m_connection;
+
+    QString m_cacheDirectory;
+    QSize m_thumbnailSize;
+
+    QHash<quint8, QByteArray> m_hashes;
+    QHash<quint8, QImage> m_thumbnails;
+
+    QList<quint8> m_pending;
+    FetchState m_fetchState;
+    bool m_locked;
+    quint8 m_fetchIndex;
+    QByteArray m_fetchHash;
+    quint16 m_transferId;
+
+signals:
+    void thumbnailChanged(quint8 index, const QImage &thumbnail);
+};
+
+#endif // QATEMTHUMBNAILCACHE_H
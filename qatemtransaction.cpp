@@ -0,0 +1,241 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "qatemtransaction.h"
+#include "qatemconnection.h"
+
+/// Time in milliseconds to wait for the switcher to acknowledge a committed transaction
+static const int ackTimeout = 1000;
+
+QAtemTransaction::QAtemTransaction(QAtemConnection *connection) :
+    QObject(connection), m_connection(connection)
+{
+    m_state = Open;
+    m_packetCount = 0;
+
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(ackTimeout);
+    connect(&m_timer, SIGNAL(timeout()),
+            this, SLOT(handleTimeout()));
+}
+
+void QAtemTransaction::addCommand(const QByteArray &key, const QByteArray &cmd, const QByteArray &payload)
+{
+    Command command;
+    command.cmd = cmd;
+    command.payload = payload;
+
+    QHash<QByteArray, int>::const_iterator it = m_commandIndexes.constFind(key);
+
+    if(it != m_commandIndexes.constEnd())
+    {
+        m_commands[it.value()] = command;
+    }
+    else
+    {
+        m_commandIndexes.insert(key, m_commands.size());
+        m_commands.append(command);
+    }
+}
+
+void QAtemTransaction::removeCommand(const QByteArray &key)
+{
+    QHash<QByteArray, int>::iterator it = m_commandIndexes.find(key);
+
+    if(it == m_commandIndexes.end())
+    {
+        return;
+    }
+
+    int index = it.value();
+    m_commandIndexes.erase(it);
+    m_commands.remove(index);
+
+    for(it = m_commandIndexes.begin(); it != m_commandIndexes.end(); ++it)
+    {
+        if(it.value() > index)
+        {
+            --it.value();
+        }
+    }
+}
+
+void QAtemTransaction::detach()
+{
+    if(m_state == Open && m_connection && m_connection->m_transaction == this)
+    {
+        m_connection->m_transaction = nullptr;
+    }
+}
+
+void QAtemTransaction::attach()
+{
+    if(m_state == Open && m_connection && !m_connection->m_transaction)
+    {
+        m_connection->m_transaction = this;
+    }
+}
+
+void QAtemTransaction::commit()
+{
+    commitTogether(QList<QAtemTransaction*>() << this);
+}
+
+void QAtemTransaction::commitTogether(const QList<QAtemTransaction*> &transactions)
+{
+    QAtemConnection *connection = nullptr;
+    QList<QAtemTransaction*> sending;
+    QVector<QPair<QByteArray, QByteArray> > commands;
+
+    foreach(QAtemTransaction *transaction, transactions)
+    {
+        if(!transaction || transaction->m_state != Open)
+        {
+            continue;
+        }
+
+        if(connection && transaction->m_connection != connection)
+        {
+            // Only commands for the same switcher can share datagrams
+            transaction->commit();
+            continue;
+        }
+
+        transaction->m_state = Committed;
+        transaction->m_commandIndexes.clear();
+
+        if(!transaction->m_connection)
+        {
+            transaction->finish(Failed);
+            continue;
+        }
+
+        if(transaction->m_connection->m_transaction == transaction)
+        {
+            transaction->m_connection->m_transaction = nullptr;
+        }
+
+        if(transaction->m_commands.isEmpty())
+        {
+            transaction->finish(Acknowledged);
+            continue;
+        }
+
+        if(!transaction->m_connection->isConnected())
+        {
+            transaction->finish(Failed);
+            continue;
+        }
+
+        connection = transaction->m_connection;
+        sending.append(transaction);
+
+        foreach(const Command &command, transaction->m_commands)
+        {
+            commands.append(qMakePair(command.cmd, command.payload));
+        }
+    }
+
+    if(sending.isEmpty())
+    {
+        return;
+    }
+
+    QVector<quint16> packetIds = connection->sendCommands(commands);
+
+    // The commands may share datagrams, every transaction waits for all of them
+    foreach(QAtemTransaction *transaction, sending)
+    {
+        transaction->m_packetIds = packetIds;
+        transaction->m_packetCount = packetIds.size();
+        connection->m_committedTransactions.append(transaction);
+        transaction->m_timer.start();
+    }
+}
+
+void QAtemTransaction::cancel()
+{
+    if(m_state != Open)
+    {
+        return;
+    }
+
+    if(m_connection && m_connection->m_transaction == this)
+    {
+        m_connection->m_transaction = nullptr;
+    }
+
+    m_commands.clear();
+    m_commandIndexes.clear();
+    finish(Cancelled);
+}
+
+void QAtemTransaction::handleAck(quint16 packetId)
+{
+    if(m_state != Committed)
+    {
+        return;
+    }
+
+    // Acks are cumulative, every packet up to and including packetId has been received
+    QVector<quint16>::iterator it = m_packetIds.begin();
+
+    while(it != m_packetIds.end())
+    {
+        if(static_cast<quint16>(packetId - *it) < 0x8000)
+        {
+            it = m_packetIds.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    if(m_packetIds.isEmpty())
+    {
+        finish(Acknowledged);
+    }
+}
+
+void QAtemTransaction::handleTimeout()
+{
+    if(m_state == Committed)
+    {
+        finish(Failed);
+    }
+}
+
+void QAtemTransaction::finish(State state)
+{
+    m_state = state;
+    m_timer.stop();
+    m_packetIds.clear();
+
+    if(m_connection)
+    {
+        m_connection->m_committedTransactions.removeAll(this);
+    }
+
+    if(state == Acknowledged)
+    {
+        emit acknowledged();
+    }
+
+    emit finished(state == Acknowledged);
+    deleteLater();
+}
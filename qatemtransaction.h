@@ -0,0 +1,122 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QATEMTRANSACTION_H
+#define QATEMTRANSACTION_H
+
+#include "libqatemcontrol_global.h"
+
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+#include <QList>
+#include <QHash>
+#include <QTimer>
+
+class QAtemConnection;
+
+/**
+ * Groups the commands of several setters so they are sent together, in as few datagrams as possible, and are
+ * applied by the switcher in the same frame. Create it with QAtemConnection::beginTransaction(), call the setters
+ * of the connection, its mix effects and downstream keys and then commit(). Setters that would not change the
+ * current state are dropped while a transaction is open, together with a command queued for the same parameter
+ * earlier in the transaction, and a command for the same parameter replaces the one queued before it. The
+ * transaction deletes itself once it has finished.
+ */
+class LIBQATEMCONTROLSHARED_EXPORT QAtemTransaction : public QObject
+{
+    Q_OBJECT
+public:
+    enum State
+    {
+        Open,         // Collecting commands
+        Committed,    // Sent, waiting for the switcher to acknowledge every datagram
+        Acknowledged, // Every datagram has been acknowledged
+        Failed,       // The connection was lost or a datagram wasn't acknowledged in time
+        Cancelled     // Cancelled before it was committed, nothing was sent
+    };
+
+    State state() const { return m_state; }
+
+    /// @returns the number of commands queued, or sent if the transaction has been committed
+    int commandCount() const { return m_commands.size(); }
+    /// @returns the number of datagrams the commands were sent in
+    int packetCount() const { return m_packetCount; }
+
+    /**
+     * Stop collecting commands without sending the ones queued, setters called afterwards are sent as usual.
+     * The queued commands are sent when commit() is called, this is used to prepare a transaction ahead of time.
+     */
+    void detach();
+    /// Collect the commands of the setters again after detach(), if no other transaction is open
+    void attach();
+
+    /**
+     * Commit the open transactions in @p transactions at once, their commands are sent in the same datagrams and in
+     * the order of the list. Each transaction is acknowledged when all of the datagrams are.
+     */
+    static void commitTogether(const QList<QAtemTransaction*> &transactions);
+
+public slots:
+    /// Send the queued commands. finished() is emitted when the switcher has acknowledged all of them.
+    void commit();
+    /**
+     * Drop the queued commands without sending them. Optimistic updates made by the setters are rolled back when
+     * the switcher doesn't confirm them.
+     */
+    void cancel();
+
+protected:
+    explicit QAtemTransaction(QAtemConnection *connection);
+
+    /// Queue @p cmd with @p payload, replacing the command queued for the parameter identified by @p key
+    void addCommand(const QByteArray &key, const QByteArray &cmd, const QByteArray &payload);
+    /// Drop the command queued for the parameter identified by @p key
+    void removeCommand(const QByteArray &key);
+    /// Mark the datagrams up to and including @p packetId as acknowledged
+    void handleAck(quint16 packetId);
+    /// Finish with @p state, emit the signals and schedule deletion
+    void finish(State state);
+
+protected slots:
+    void handleTimeout();
+
+private:
+    struct Command
+    {
+        QByteArray cmd;
+        QByteArray payload;
+    };
+
+    QPointer<QAtemConnection> m_connection;
+    State m_state;
+    QVector<Command> m_commands;
+    QHash<QByteArray, int> m_commandIndexes;
+    QVector<quint16> m_packetIds;
+    int m_packetCount;
+    QTimer m_timer;
+
+    friend class QAtemConnection;
+
+signals:
+    /// Emitted when the switcher has acknowledged every datagram of the transaction
+    void acknowledged();
+    /// Emitted when the transaction has finished, @p acknowledged is false if it failed or was cancelled
+    void finished(bool acknowledged);
+};
+
+#endif // QATEMTRANSACTION_H
@@ -212,6 +212,47 @@ namespace QAtem
         QString description;
     };
 
+    struct LIBQATEMCONTROLSHARED_EXPORT TransferTelemetry
+    {
+        TransferTelemetry() :
+            transferId(0), download(false), size(0), bytesSent(0), bytesAcked(0), chunksInFlight(0),
+            currentThroughput(0), averageThroughput(0), elapsedTime(0), estimatedTimeRemaining(-1),
+            creditWindows(0), creditedChunks(0), lastCreditWindow(0),
+            restarts(0), retransmittedBytes(0), lockWaitTime(0)
+        {
+        }
+
+        quint16 transferId;
+        bool download;
+        qint64 size; // Bytes, 0 for downloads as the size isn't known in advance
+        qint64 bytesSent; // Bytes sent to the switcher, unused for downloads
+        qint64 bytesAcked; // Bytes acknowledged by the switcher, or received from it for downloads
+        int chunksInFlight; // Data chunks sent but not acknowledged yet
+        double currentThroughput; // Bytes per second over the last half second
+        double averageThroughput; // Bytes per second since the transfer started
+        qint64 elapsedTime; // Milliseconds since the transfer started
+        qint64 estimatedTimeRemaining; // Milliseconds, -1 if unknown
+        quint32 creditWindows; // Number of times the switcher asked for more data
+        quint32 creditedChunks; // Total number of chunks the switcher asked for
+        quint8 lastCreditWindow; // Number of chunks asked for in the last request
+        quint32 restarts; // Number of times the transfer was restarted after the connection was lost
+        qint64 retransmittedBytes; // Bytes that had to be sent again because of restarts
+        qint64 lockWaitTime; // Milliseconds spent waiting for the store lock, including after restarts
+    };
+
+    enum ImageScaleMode
+    {
+        CropImage, // Center the image without scaling, cropping or padding it to the frame size
+        FitImage, // Scale the image to fit inside the frame keeping the aspect ratio, padding the rest
+        FillImage // Scale the image to cover the frame keeping the aspect ratio, cropping the rest
+    };
+
+    enum ColorMatrix
+    {
+        Bt601Matrix, // Standard definition video modes
+        Bt709Matrix // High definition and ultra high definition video modes
+    };
+
     enum MacroRunningState
     {
         MacroStoped,
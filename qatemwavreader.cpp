@@ -0,0 +1,255 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "qatemwavreader.h"
+
+#include <QtEndian>
+
+#include <math.h>
+
+// WAVE_FORMAT_PCM, WAVE_FORMAT_IEEE_FLOAT and WAVE_FORMAT_EXTENSIBLE
+static const quint16 FormatPcm = 0x0001;
+static const quint16 FormatFloat = 0x0003;
+static const quint16 FormatExtensible = 0xfffe;
+
+QAtemWavReader::QAtemWavReader(const QString &fileName, QObject *parent) :
+    QIODevice(parent), m_file(fileName)
+{
+    m_format = 0;
+    m_channelCount = 0;
+    m_sampleRate = 0;
+    m_bitsPerSample = 0;
+    m_blockAlign = 0;
+    m_dataOffset = 0;
+    m_frameCount = 0;
+}
+
+QAtemWavReader::~QAtemWavReader()
+{
+    close();
+}
+
+bool QAtemWavReader::open(OpenMode mode)
+{
+    if((mode & QIODevice::WriteOnly) || !m_file.open(QIODevice::ReadOnly))
+    {
+        setErrorString(m_file.errorString());
+        return false;
+    }
+
+    if(!parseHeader())
+    {
+        m_file.close();
+        return false;
+    }
+
+    // Reads are converted in whole sample frames, so don't let QIODevice split them up
+    return QIODevice::open(mode | QIODevice::Unbuffered);
+}
+
+void QAtemWavReader::close()
+{
+    QIODevice::close();
+    m_file.close();
+}
+
+bool QAtemWavReader::parseHeader()
+{
+    QByteArray riff = m_file.read(12);
+
+    if(riff.size() != 12 || !riff.startsWith("RIFF") || riff.mid(8, 4) != "WAVE")
+    {
+        setErrorString(tr("Not a WAV file"));
+        return false;
+    }
+
+    bool hasFormat = false;
+
+    while(!m_file.atEnd())
+    {
+        QByteArray chunk = m_file.read(8);
+
+        if(chunk.size() != 8)
+        {
+            break;
+        }
+
+        quint32 chunkSize = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(chunk.constData() + 4));
+        qint64 chunkStart = m_file.pos();
+
+        if(chunk.startsWith("fmt "))
+        {
+            QByteArray fmt = m_file.read(chunkSize);
+
+            if(fmt.size() < 16)
+            {
+                break;
+            }
+
+            const uchar *data = reinterpret_cast<const uchar*>(fmt.constData());
+            m_format = qFromLittleEndian<quint16>(data);
+            m_channelCount = qFromLittleEndian<quint16>(data + 2);
+            m_sampleRate = qFromLittleEndian<quint32>(data + 4);
+            m_blockAlign = qFromLittleEndian<quint16>(data + 12);
+            m_bitsPerSample = qFromLittleEndian<quint16>(data + 14);
+
+            // The real format is in the first two bytes of the sub format GUID
+            if(m_format == FormatExtensible && fmt.size() >= 26)
+            {
+                m_format = qFromLittleEndian<quint16>(data + 24);
+            }
+
+            hasFormat = true;
+        }
+        else if(chunk.startsWith("data"))
+        {
+            if(!hasFormat)
+            {
+                break;
+            }
+
+            m_dataOffset = m_file.pos();
+            qint64 dataSize = qMin(static_cast<qint64>(chunkSize), m_file.size() - m_dataOffset);
+            m_frameCount = m_blockAlign ? dataSize / m_blockAlign : 0;
+
+            bool supported = (m_format == FormatPcm && (m_bitsPerSample == 8 || m_bitsPerSample == 16 || m_bitsPerSample == 24 || m_bitsPerSample == 32)) ||
+                    (m_format == FormatFloat && m_bitsPerSample == 32);
+
+            if(!supported || m_channelCount == 0 || m_blockAlign < m_channelCount * (m_bitsPerSample / 8))
+            {
+                setErrorString(tr("Unsupported WAV sample format"));
+                return false;
+            }
+
+            if(m_sampleRate != 48000)
+            {
+                setErrorString(tr("Only 48 kHz audio is supported, the file is %1 Hz").arg(m_sampleRate));
+                return false;
+            }
+
+            return true;
+        }
+
+        // Chunks are padded to an even size
+        if(!m_file.seek(chunkStart + chunkSize + (chunkSize & 1)))
+        {
+            break;
+        }
+    }
+
+    setErrorString(tr("No audio data found in the WAV file"));
+    return false;
+}
+
+qint64 QAtemWavReader::size() const
+{
+    return m_frameCount * OutputFrameSize;
+}
+
+bool QAtemWavReader::seek(qint64 pos)
+{
+    // Only whole sample frames can be seeked to
+    if(pos % OutputFrameSize || pos > size() || !m_file.seek(m_dataOffset + ((pos / OutputFrameSize) * m_blockAlign)))
+    {
+        return false;
+    }
+
+    return QIODevice::seek(pos);
+}
+
+/// @returns channel @p channel of the frame at @p frame as a 24 bit sample
+static inline qint32 readSample(const uchar *frame, int channel, quint16 format, quint16 bitsPerSample)
+{
+    switch(bitsPerSample)
+    {
+    case 8:
+        return (static_cast<qint32>(frame[channel]) - 128) << 16;
+    case 16:
+        return static_cast<qint32>(qFromLittleEndian<qint16>(frame + (channel * 2))) * 256;
+    case 24:
+    {
+        const uchar *s = frame + (channel * 3);
+        return static_cast<qint32>(static_cast<quint32>(s[0]) << 8 | static_cast<quint32>(s[1]) << 16 | static_cast<quint32>(s[2]) << 24) >> 8;
+    }
+    case 32:
+    {
+        quint32 bits = qFromLittleEndian<quint32>(frame + (channel * 4));
+
+        if(format == FormatFloat)
+        {
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            value = qBound(-1.0f, value, 1.0f);
+            return static_cast<qint32>(lrintf(value * 8388607.0f));
+        }
+
+        return static_cast<qint32>(bits) >> 8;
+    }
+    default:
+        return 0;
+    }
+}
+
+qint64 QAtemWavReader::readData(char *data, qint64 maxSize)
+{
+    qint64 firstFrame = pos() / OutputFrameSize;
+    qint64 frames = qMin(maxSize / OutputFrameSize, m_frameCount - firstFrame);
+
+    if(frames <= 0)
+    {
+        return 0;
+    }
+
+    // Convert in blocks so the buffer stays small no matter how much is asked for
+    frames = qMin(frames, static_cast<qint64>(16384));
+    m_buffer.resize(static_cast<int>(frames * m_blockAlign));
+    qint64 bytesRead = m_file.read(m_buffer.data(), m_buffer.size());
+
+    if(bytesRead < m_blockAlign)
+    {
+        setErrorString(m_file.errorString());
+        return -1;
+    }
+
+    frames = bytesRead / m_blockAlign;
+    const uchar *src = reinterpret_cast<const uchar*>(m_buffer.constData());
+    uchar *dst = reinterpret_cast<uchar*>(data);
+    const int rightChannel = (m_channelCount > 1) ? 1 : 0;
+
+    for(qint64 i = 0; i < frames; ++i, src += m_blockAlign, dst += OutputFrameSize)
+    {
+        qint32 left = readSample(src, 0, m_format, m_bitsPerSample);
+        qint32 right = readSample(src, rightChannel, m_format, m_bitsPerSample);
+
+        dst[0] = static_cast<uchar>(left >> 16);
+        dst[1] = static_cast<uchar>(left >> 8);
+        dst[2] = static_cast<uchar>(left);
+        dst[3] = static_cast<uchar>(right >> 16);
+        dst[4] = static_cast<uchar>(right >> 8);
+        dst[5] = static_cast<uchar>(right);
+    }
+
+    return frames * OutputFrameSize;
+}
+
+qint64 QAtemWavReader::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+
+    return -1;
+}
@@ -0,0 +1,72 @@
+/*
+Copyright 2020  Peter Simonsson <peter.simonsson@gmail.com>
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QATEMWAVREADER_H
+#define QATEMWAVREADER_H
+
+#include "libqatemcontrol_global.h"
+
+#include <QIODevice>
+#include <QFile>
+
+/**
+ * Reads a WAV file as the switcher's clip audio sample format, 48 kHz stereo 24 bit big endian samples.
+ * 8, 16, 24 and 32 bit integer and 32 bit float PCM is converted in blocks as it's read, mono files are
+ * duplicated to both channels and only the first two channels of multi channel files are used.
+ */
+class LIBQATEMCONTROLSHARED_EXPORT QAtemWavReader : public QIODevice
+{
+    Q_OBJECT
+public:
+    explicit QAtemWavReader(const QString &fileName, QObject *parent = nullptr);
+    ~QAtemWavReader();
+
+    /// Open the WAV file, @p mode has to be QIODevice::ReadOnly. @returns false if the file isn't a supported WAV file.
+    bool open(OpenMode mode) override;
+    void close() override;
+
+    /// @returns the size of the converted data
+    qint64 size() const override;
+    bool seek(qint64 pos) override;
+
+    quint16 channelCount() const { return m_channelCount; }
+    quint32 sampleRate() const { return m_sampleRate; }
+    quint16 bitsPerSample() const { return m_bitsPerSample; }
+    qint64 frameCount() const { return m_frameCount; }
+
+    /// Bytes per converted stereo sample frame
+    static const int OutputFrameSize = 6;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    bool parseHeader();
+
+    QFile m_file;
+    quint16 m_format;
+    quint16 m_channelCount;
+    quint32 m_sampleRate;
+    quint16 m_bitsPerSample;
+    quint16 m_blockAlign;
+    qint64 m_dataOffset;
+    qint64 m_frameCount;
+    QByteArray m_buffer;
+};
+
+#endif // QATEMWAVREADER_H